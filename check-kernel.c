@@ -0,0 +1,329 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+// Check the projection kernel of lp-kernel.h against libm in double. The sine
+// and cosine polynomials are swept densely, with their coefficients as written
+// and as the floats that C and GLSL use, and time against libm on the CPU.
+// The chart, polar, octahedral, and unwrap mappings exist only in GLSL, so
+// they are rendered over a grid on a headless context and read back.
+
+#include <GL/glew.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "gl-context.h"
+#include "gl-program.h"
+#include "lp-kernel.h"
+#include "lp-kernel-fs.h"
+
+//------------------------------------------------------------------------------
+
+#define SWEEP  (1 << 24)
+#define GRID   512
+#define TRIALS 8
+
+#define ERR_SIN  3.5e-9
+#define ERR_COS  5.1e-8
+#define ERR_FSIN 5.0e-8
+#define ERR_FCOS 8.5e-8
+#define ERR_MAP  1.0e-5
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+//------------------------------------------------------------------------------
+
+// The coefficient macros expand where they are used, so redefining KERNEL_F
+// between these gives the polynomials with the coefficients as written, in
+// double, and then as the CPU passes evaluate them, with float coefficients.
+
+#undef  KERNEL_F
+#define KERNEL_F(x) (x)
+
+static double dsin(double x) { return KERNEL_SIN(x, x * x); }
+static double dcos(double x) { return KERNEL_COS(x * x); }
+
+#undef  KERNEL_F
+#define KERNEL_F(x) ((float) (x))
+
+static double fsin(double x) { return KERNEL_SIN(x, x * x); }
+static double fcos(double x) { return KERNEL_COS(x * x); }
+
+// Return the greatest error of FN in [-1, 1] against G at pi/2 x.
+
+static double sweep(double (*fn)(double), double (*g)(double))
+{
+    double e = 0.0;
+    int    i;
+
+    for (i = 0; i <= SWEEP; i++)
+    {
+        const double x = 2.0 * i / SWEEP - 1.0;
+
+        e = fmax(e, fabs(fn(x) - g(M_PI_2 * x)));
+    }
+    return e;
+}
+
+// Time TRIALS sweeps of the sine and cosine by FS and FC, and return the mean
+// time per pair in nanoseconds. The sum keeps the work from being discarded.
+
+static double sum;
+
+static double time_pair(double (*fs)(double), double (*fc)(double), double k)
+{
+    double t0 = now();
+    int    i;
+    int    j;
+
+    for     (j = 0; j < TRIALS; j++)
+        for (i = 0; i <= SWEEP; i++)
+        {
+            const double x = k * (2.0 * i / SWEEP - 1.0);
+
+            sum += fs(x) + fc(x);
+        }
+
+    return 1e9 * (now() - t0) / TRIALS / (SWEEP + 1.0);
+}
+
+static double lsin(double x) { return sin(x); }
+static double lcos(double x) { return cos(x); }
+
+//------------------------------------------------------------------------------
+
+// Evaluate one mapping of the kernel at each pixel of the grid, with v the
+// pixel center in [0, 1]. Mode 0 gives the chart, 1 the polar map, 2 the
+// octahedral map, and 3 the unwrap of the chart direction.
+
+static const char vert[] =
+    "void main()\n"
+    "{\n"
+    "    gl_Position = gl_Vertex;\n"
+    "}\n";
+
+static const char frag[] =
+    "uniform int   mode;\n"
+    "uniform float size;\n"
+    "vec2 unwrap(vec3);\n"
+    "vec3 chart (vec2);\n"
+    "vec3 polar (vec2);\n"
+    "vec3 octa  (vec2);\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 v = gl_FragCoord.xy / size;\n"
+    "    vec3 d;\n"
+    "    if      (mode == 0) d = chart(v);\n"
+    "    else if (mode == 1) d = polar(2.0 * v - 1.0);\n"
+    "    else if (mode == 2) d = octa (2.0 * v - 1.0);\n"
+    "    else                d = vec3(unwrap(chart(v)), 0.0);\n"
+    "    gl_FragColor = vec4(d, 1.0);\n"
+    "}\n";
+
+// Give the same mappings in double by libm, from their definitions. Return
+// false where a mapping is not defined, at the center of the polar map and
+// near the far pole of the unwrap.
+
+static int expect(int mode, double x, double y, double *d)
+{
+    double a;
+    double b;
+    double r;
+    double h;
+
+    if (mode == 0 || mode == 3)
+    {
+        a = M_PI - 2.0 * M_PI * x;
+        b = M_PI_2 -     M_PI * y;
+
+        d[0] =  sin(a) * cos(b);
+        d[1] = -sin(b);
+        d[2] =  cos(a) * cos(b);
+
+        if (mode == 3)
+        {
+            if (d[2] < -0.9)
+                return 0;
+
+            r = sin(0.5 * acos(d[2])) / hypot(d[0], d[1]);
+
+            d[0] *= r;
+            d[1] *= r;
+            d[2]  = 0.0;
+        }
+        return 1;
+    }
+    if (mode == 1)
+    {
+        x = 2.0 * x - 1.0;
+        y = 2.0 * y - 1.0;
+
+        if ((r = hypot(x, y)) < 1e-3)
+            return 0;
+
+        b = M_PI_2 * (1.0 - r);
+
+        d[0] =  cos(b) * x / r;
+        d[1] = -sin(b);
+        d[2] =  cos(b) * y / r;
+
+        return 1;
+    }
+    else
+    {
+        x = 2.0 * x - 1.0;
+        y = 2.0 * y - 1.0;
+
+        if ((h = 1.0 - fabs(x) - fabs(y)) < 0.0)
+        {
+            a = (1.0 - fabs(y)) * (x < 0.0 ? -1.0 : 1.0);
+            b = (1.0 - fabs(x)) * (y < 0.0 ? -1.0 : 1.0);
+            x = a;
+            y = b;
+        }
+        r = sqrt(x * x + h * h + y * y);
+
+        d[0] =  x / r;
+        d[1] = -h / r;
+        d[2] =  y / r;
+
+        return 1;
+    }
+}
+
+// Render the mappings and return the greatest error of any component of any,
+// or a negative value if they cannot be rendered.
+
+static double check_maps(GLuint kernel)
+{
+    static const char *name[] = { "chart", "polar", "octa", "unwrap" };
+
+    gl_program P;
+    GLuint     frame;
+    GLuint     color;
+    GLfloat   *p;
+    double     e = 0.0;
+    double     d[3];
+    int        m;
+    int        i;
+    int        j;
+    int        k;
+
+    gl_init_library(&P, (const unsigned char *) vert, sizeof (vert) - 1,
+                        (const unsigned char *) frag, sizeof (frag) - 1,
+                        kernel);
+
+    if (P.program == 0 || !(p = (GLfloat *) malloc(GRID * GRID * 3
+                                                   * sizeof (GLfloat))))
+        return -1.0;
+
+    glGenTextures(1, &color);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, GRID, GRID, 0,
+                 GL_RGBA, GL_FLOAT, NULL);
+
+    glGenFramebuffers(1, &frame);
+    glBindFramebuffer(GL_FRAMEBUFFER, frame);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, color, 0);
+    glViewport(0, 0, GRID, GRID);
+    glUseProgram(P.program);
+    gl_uniform1f(&P, "size", GRID);
+
+    for (m = 0; m < 4; m++)
+    {
+        double f = 0.0;
+
+        gl_uniform1i(&P, "mode", m);
+
+        glBegin(GL_QUADS);
+        {
+            glVertex2f(-1.0f, -1.0f);
+            glVertex2f(+1.0f, -1.0f);
+            glVertex2f(+1.0f, +1.0f);
+            glVertex2f(-1.0f, +1.0f);
+        }
+        glEnd();
+
+        glReadPixels(0, 0, GRID, GRID, GL_RGB, GL_FLOAT, p);
+
+        for     (i = 0; i < GRID; i++)
+            for (j = 0; j < GRID; j++)
+                if (expect(m, (j + 0.5) / GRID, (i + 0.5) / GRID, d))
+                    for (k = 0; k < 3; k++)
+                        f = fmax(f, fabs(p[(i * GRID + j) * 3 + k] - d[k]));
+
+        printf("check-kernel: %-6s %d^2 on GL, error %.2e\n",
+               name[m], GRID, f);
+        e = fmax(e, f);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &frame);
+    glDeleteTextures(1, &color);
+    gl_free_program(&P);
+    free(p);
+
+    return e;
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+    const double es = sweep(dsin, sin);
+    const double ec = sweep(dcos, cos);
+    const double fs = sweep(fsin, sin);
+    const double fc = sweep(fcos, cos);
+
+    gl_context *C;
+    GLuint      kernel;
+    double      em = -1.0;
+    int         ok;
+
+    printf("check-kernel: sin error %.2e, cos error %.2e, as written\n",
+           es, ec);
+    printf("check-kernel: sin error %.2e, cos error %.2e, float coefficients\n",
+           fs, fc);
+    printf("check-kernel: sin and cos %.2f ns by kernel, %.2f ns by libm\n",
+           time_pair(fsin, fcos, 1.0), time_pair(lsin, lcos, M_PI_2));
+
+    if ((C = gl_open_context()))
+    {
+        gl_bind_context(C, 1);
+        glewInit();
+
+        if ((kernel = gl_load_fshader(lp_kernel_h, lp_kernel_h_len)))
+        {
+            em = check_maps(kernel);
+            glDeleteShader(kernel);
+        }
+        gl_bind_context(C, 0);
+        gl_free_context(C);
+    }
+    if (em < 0.0)
+        fprintf(stderr, "check-kernel: mappings could not be rendered\n");
+
+    ok = es <= ERR_SIN  && ec <= ERR_COS
+      && fs <= ERR_FSIN && fc <= ERR_FCOS
+      && em >= 0.0      && em <= ERR_MAP;
+
+    return (ok && sum == sum) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,279 @@
+// GL-KTX Copyright (C) 2011 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+// Check that a cube map written by gl_save_ktx reads back texel for texel by
+// gl_load_ktx, at every level, on a headless context. Then time that load
+// against a minimal loader of the same cube as a six-page float TIFF, as the
+// cube export writes it, whose mipmaps must be generated at load.
+
+#include <GL/glew.h>
+#include <tiffio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gl-context.h"
+#include "gl-ktx.h"
+
+//------------------------------------------------------------------------------
+
+#define SIZE   512
+#define LEVELS 10
+#define TRIALS 8
+
+static const char *ktx_path  = "check-ktx.ktx";
+static const char *tiff_path = "check-ktx.tif";
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Return the size of level L of the cube.
+
+static int level(int l)
+{
+    return (SIZE >> l) ? (SIZE >> l) : 1;
+}
+
+//------------------------------------------------------------------------------
+
+// Make a cube map whose every level and face holds distinct HDR texels, so that
+// a level or face out of place shows as a difference.
+
+static GLuint make_cube(float *p)
+{
+    const GLenum T = GL_TEXTURE_CUBE_MAP;
+
+    GLuint       o;
+    unsigned int l;
+    unsigned int k;
+    unsigned int i;
+
+    glGenTextures(1, &o);
+    glBindTexture(T,  o);
+
+    for     (l = 0; l < LEVELS; l++)
+        for (k = 0; k < 6;      k++)
+        {
+            const unsigned int m = level(l);
+
+            for (i = 0; i < m * m * 4; i++)
+                p[i] = ((7919u * i + 104729u * k + 1299709u * l) % 65521u)
+                     / 64.0f;
+
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, l, GL_RGBA16F,
+                         m, m, 0, GL_RGBA, GL_FLOAT, p);
+        }
+
+    glTexParameteri(T, GL_TEXTURE_MAX_LEVEL, LEVELS - 1);
+
+    return o;
+}
+
+// Read back every level and face of cube map O as half floats, smallest level
+// last, as it was uploaded. Return the number of values read.
+
+static size_t read_cube(GLuint o, unsigned short *p)
+{
+    size_t n = 0;
+    int    l;
+    int    k;
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, o);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    for     (l = 0; l < LEVELS; l++)
+        for (k = 0; k < 6;      k++)
+        {
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, l,
+                          GL_RGBA, GL_HALF_FLOAT, p);
+            p += (size_t) level(l) * level(l) * 4;
+            n += (size_t) level(l) * level(l) * 4;
+        }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return n;
+}
+
+//------------------------------------------------------------------------------
+
+// Write the base level of cube map O as six pages of RGB 32-bit float.
+
+static int save_tiff(GLuint o, float *p)
+{
+    TIFF *T;
+    int   k;
+    int   i;
+
+    if ((T = TIFFOpen(tiff_path, "w")) == 0)
+        return 0;
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, o);
+
+    for (k = 0; k < 6; k++)
+    {
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, 0,
+                      GL_RGB, GL_FLOAT, p);
+
+        TIFFSetField(T, TIFFTAG_IMAGEWIDTH,      SIZE);
+        TIFFSetField(T, TIFFTAG_IMAGELENGTH,     SIZE);
+        TIFFSetField(T, TIFFTAG_BITSPERSAMPLE,   32);
+        TIFFSetField(T, TIFFTAG_SAMPLESPERPIXEL, 3);
+        TIFFSetField(T, TIFFTAG_SAMPLEFORMAT,    SAMPLEFORMAT_IEEEFP);
+        TIFFSetField(T, TIFFTAG_PHOTOMETRIC,     PHOTOMETRIC_RGB);
+        TIFFSetField(T, TIFFTAG_PLANARCONFIG,    PLANARCONFIG_CONTIG);
+
+        for (i = 0; i < SIZE; i++)
+            TIFFWriteScanline(T, p + (size_t) i * SIZE * 3, i, 0);
+
+        TIFFWriteDirectory(T);
+    }
+    TIFFClose(T);
+    return 1;
+}
+
+// Load the six-page TIFF as a half float cube map and generate its mipmaps.
+
+static GLuint load_tiff(float *p)
+{
+    const GLenum T = GL_TEXTURE_CUBE_MAP;
+
+    GLuint o = 0;
+    TIFF  *F;
+    int    k;
+    int    i;
+
+    if ((F = TIFFOpen(tiff_path, "r")))
+    {
+        glGenTextures(1, &o);
+        glBindTexture(T,  o);
+
+        for (k = 0; k < 6 && TIFFSetDirectory(F, k); k++)
+        {
+            for (i = 0; i < SIZE; i++)
+                TIFFReadScanline(F, p + (size_t) i * SIZE * 3, i, 0);
+
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, 0, GL_RGBA16F,
+                         SIZE, SIZE, 0, GL_RGB, GL_FLOAT, p);
+        }
+        glGenerateMipmap(T);
+        TIFFClose(F);
+    }
+    return o;
+}
+
+//------------------------------------------------------------------------------
+
+// Time TRIALS loads by FN and return the mean in milliseconds.
+
+static double time_load(GLuint (*fn)(void *), void *data)
+{
+    double t = 0.0;
+    int    i;
+
+    for (i = 0; i < TRIALS; i++)
+    {
+        const double t0 = now();
+        GLuint       o  = fn(data);
+
+        glFinish();
+        t += now() - t0;
+
+        glDeleteTextures(1, &o);
+    }
+    return 1000.0 * t / TRIALS;
+}
+
+static GLuint load_ktx(void *data)
+{
+    return gl_load_ktx(ktx_path);
+}
+
+static GLuint load_tif(void *data)
+{
+    return load_tiff((float *) data);
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+    const size_t n = (size_t) SIZE * SIZE * 4;
+    const size_t z = n * 6 * 2;
+
+    unsigned short *a = (unsigned short *) malloc(z * sizeof (unsigned short));
+    unsigned short *b = (unsigned short *) malloc(z * sizeof (unsigned short));
+    float          *p = (float          *) malloc(n * sizeof (float));
+
+    gl_context *C;
+    GLuint      o;
+    GLuint      q;
+    size_t      d = 0;
+    size_t      m;
+    size_t      i;
+
+    if (!a || !b || !p || (C = gl_open_context()) == 0)
+    {
+        fprintf(stderr, "check-ktx: no offscreen GL context\n");
+        return EXIT_FAILURE;
+    }
+    gl_bind_context(C, 1);
+    glewInit();
+
+    // Round trip the cube and compare every texel of every level.
+
+    memset(a, 0, z * sizeof (unsigned short));
+    memset(b, 0, z * sizeof (unsigned short));
+
+    o = make_cube(p);
+    m = read_cube(o, a);
+
+    if (!gl_save_ktx(ktx_path, o, SIZE, LEVELS) || !(q = gl_load_ktx(ktx_path)))
+    {
+        fprintf(stderr, "check-ktx: %s did not round trip\n", ktx_path);
+        return EXIT_FAILURE;
+    }
+    read_cube(q, b);
+    glDeleteTextures(1, &q);
+
+    for (i = 0; i < m; i++)
+        if (a[i] != b[i])
+            d++;
+
+    printf("check-ktx: %d levels of %d^2, %lu of %lu values differ\n",
+           LEVELS, SIZE, (unsigned long) d, (unsigned long) m);
+
+    // Time the KTX load against the TIFF load with mipmap generation.
+
+    if (save_tiff(o, p))
+        printf("check-ktx: load ktx %.2f ms, tiff %.2f ms\n",
+               time_load(load_ktx, 0), time_load(load_tif, p));
+
+    glDeleteTextures(1, &o);
+    gl_bind_context(C, 0);
+    gl_free_context(C);
+
+    remove(ktx_path);
+    remove(tiff_path);
+
+    free(p);
+    free(b);
+    free(a);
+
+    return d ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,239 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+// Check merge_bracket against a plain per-pixel weighted average, which finds
+// the hat weight and linearizes every sample as it goes, in double. Brackets
+// of 8 and 16 bits are merged with and without a response curve, and the
+// greatest relative difference must stay below MERGE_ERR. Both are timed, the
+// merge on as many threads as task_split gives it, the reference on one.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "lp-merge.h"
+#include "lp-task.h"
+
+//------------------------------------------------------------------------------
+
+#define W 2048
+#define H 1024
+#define C 3
+#define N 5
+#define M 256
+
+#define MERGE_ERR 1.0e-5
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+//------------------------------------------------------------------------------
+
+// The reference decodes and weighs each sample as a merge tool would, with
+// the same rules as the merge for the curve and for clipping.
+
+static double srgb(double v)
+{
+    return (v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+static double response(double v, int b, const float *g, int m)
+{
+    if (g && m > 1)
+    {
+        double x = v * (m - 1);
+        int    i = (int) floor(x);
+
+        if (i <  0)     return g[0];
+        if (i >= m - 1) return g[m - 1];
+
+        return g[i] + (x - i) * (g[i + 1] - g[i]);
+    }
+    return (b == 8) ? srgb(v) : v;
+}
+
+static int sample(const void *p, int b, size_t i)
+{
+    return (b == 8) ? ((const unsigned char  *) p)[i]
+                    : ((const unsigned short *) p)[i];
+}
+
+static void reference(float *q, const void **p, const float *t, int n,
+                      int w, int h, int c, int b, const float *g, int m)
+{
+    const double z = (1 << b) - 1;
+    const size_t s = (size_t) w * h * c;
+
+    size_t i;
+    int    lo = 0;
+    int    hi = 0;
+    int    k;
+
+    for (k = 1; k < n; k++)
+    {
+        if (t[k] < t[lo]) lo = k;
+        if (t[k] > t[hi]) hi = k;
+    }
+
+    for (i = 0; i < s; i++)
+    {
+        double num = 0.0;
+        double den = 0.0;
+
+        for (k = 0; k < n; k++)
+        {
+            const double v = sample(p[k], b, i) / z;
+            const double a = 1.0 - fabs(2.0 * v - 1.0);
+
+            num += a * response(v, b, g, m) / t[k];
+            den += a;
+        }
+
+        if (den > 0.0)
+            q[i] = (float) (num / den);
+        else if (sample(p[lo], b, i) / z > 0.5)
+            q[i] = (float) (response(sample(p[lo], b, i) / z, b, g, m) / t[lo]);
+        else
+            q[i] = (float) (response(sample(p[hi], b, i) / z, b, g, m) / t[hi]);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Expose a smooth radiance field with a grid of hot spots at time T, encode it
+// with a plain gamma, and quantize it to B bits with dither, clipping as a
+// camera would.
+
+static void *expose(int b, float t, unsigned int seed)
+{
+    const int    z = (1 << b) - 1;
+    const size_t s = (size_t) W * H * C;
+
+    void  *p;
+    size_t i;
+
+    if ((p = malloc(s * b / 8)))
+        for (i = 0; i < s; i++)
+        {
+            const int    x = (int) ((i / C) % W);
+            const int    y = (int) ((i / C) / W);
+            const double r = 0.02 + 0.5 * (1.0 + sin(x * 0.01 + i % C))
+                                        * (1.0 + cos(y * 0.013))
+                               + (((x / 64 + y / 64) % 7 == 0) ? 20.0 : 0.0);
+
+            const double v = pow(fmin(r * t, 1.0), 1.0 / 2.2);
+
+            int u;
+
+            seed = seed * 1103515245u + 12345u;
+
+            u = (int) floor(v * z + (seed >> 16) / 65536.0);
+            u = (u < 0) ? 0 : ((u > z) ? z : u);
+
+            if (b == 8) ((unsigned char  *) p)[i] = (unsigned char)  u;
+            else        ((unsigned short *) p)[i] = (unsigned short) u;
+        }
+
+    return p;
+}
+
+// Merge and check one bracket of B bits, with or without curve G. Return the
+// greatest relative difference from the reference.
+
+static double check(int b, const float *g, const char *name)
+{
+    const size_t s = (size_t) W * H * C;
+
+    const void *p[N];
+    float       t[N];
+    float      *q;
+    float      *r;
+    double      e = 0.0;
+    double      t0;
+    double      t1;
+    double      t2;
+    size_t      i;
+    int         k;
+
+    for (k = 0; k < N; k++)
+    {
+        t[k] = (float) ldexp(1.0, k - N / 2) / 8.0f;
+        p[k] = expose(b, t[k], 1u + k);
+    }
+
+    t0 = now();
+    q  = merge_bracket(p, t, N, W, H, C, b, g, g ? M : 0);
+    t1 = now();
+
+    if (q && (r = (float *) malloc(s * sizeof (float))))
+    {
+        reference(r, p, t, N, W, H, C, b, g, g ? M : 0);
+        t2 = now();
+
+        for (i = 0; i < s; i++)
+        {
+            const double d = fabs(q[i] - r[i]) / fmax(fabs(r[i]), 1.0e-6);
+
+            if (e < d)
+                e = d;
+        }
+
+        printf("check-merge: %-12s merge %6.1f ms, reference %6.1f ms, "
+               "%4.1fx, error %.2e\n", name,
+               1000.0 * (t1 - t0), 1000.0 * (t2 - t1),
+               (t2 - t1) / (t1 - t0), e);
+        free(r);
+    }
+    else e = HUGE_VAL;
+
+    for (k = 0; k < N; k++)
+        free((void *) p[k]);
+
+    free(q);
+
+    return e;
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+    float  g[M];
+    double e = 0.0;
+    int    i;
+
+    // A curve with a toe and a shoulder, unlike either default.
+
+    for (i = 0; i < M; i++)
+    {
+        const double x = (double) i / (M - 1);
+
+        g[i] = (float) (x * x * (3.0 - 2.0 * x) * 0.5 + x * x * 0.5);
+    }
+
+    printf("check-merge: %d exposures of %d x %d x %d, %d threads\n",
+           N, W, H, C, task_count());
+
+    e = fmax(e, check( 8, 0, "8-bit sRGB"));
+    e = fmax(e, check( 8, g, "8-bit curve"));
+    e = fmax(e, check(16, 0, "16-bit"));
+    e = fmax(e, check(16, g, "16-bit curve"));
+
+    return (e < MERGE_ERR) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
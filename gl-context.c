@@ -0,0 +1,283 @@
+// GL-CONTEXT Copyright (C) 2011 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+// A gl_context is a second OpenGL context sharing textures and buffers with
+// the context current at the time of its creation, for use by another thread.
+// It renders only to framebuffer objects, so its drawable is nominal. Create
+// and free it on the thread owning the original context, and bind it on the
+// thread that will use it.
+//
+// An open context is instead independent of any other, with an offscreen
+// drawable of its own, for headless use. It may be created, bound, and freed
+// on any one thread, and any number may be used at once on separate threads.
+
+#include <stdlib.h>
+
+#include "gl-context.h"
+
+//------------------------------------------------------------------------------
+// WGL shared context
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+struct gl_context
+{
+    HDC   device;
+    HGLRC context;
+};
+
+gl_context *gl_init_context(void)
+{
+    gl_context *C = 0;
+
+    HDC   device = wglGetCurrentDC();
+    HGLRC share  = wglGetCurrentContext();
+
+    if (device && share && (C = (gl_context *) calloc(1, sizeof (gl_context))))
+    {
+        C->device  = device;
+
+        if ((C->context = wglCreateContext(device)))
+            if (wglShareLists(share, C->context))
+                return C;
+
+        if (C->context)
+            wglDeleteContext(C->context);
+
+        free(C);
+    }
+    return 0;
+}
+
+// WGL offers no drawable without a window, so open contexts are unsupported.
+
+gl_context *gl_open_context(void)
+{
+    return 0;
+}
+
+void gl_bind_context(gl_context *C, int b)
+{
+    if (b)
+        wglMakeCurrent(C->device, C->context);
+    else
+        wglMakeCurrent(NULL, NULL);
+}
+
+void gl_free_context(gl_context *C)
+{
+    wglDeleteContext(C->context);
+    free(C);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// GLX shared context
+//
+// The new context uses the frame buffer configuration of the current one and
+// a 1x1 pbuffer drawable. Both contexts share the current display connection,
+// so the application must have initialized Xlib for threads. An open context
+// has a display connection of its own, which it closes when freed.
+
+#ifdef __linux__
+
+#include <GL/glx.h>
+
+struct gl_context
+{
+    Display   *display;
+    GLXPbuffer pbuffer;
+    GLXContext context;
+    int        own;
+};
+
+gl_context *gl_init_context(void)
+{
+    gl_context *C = 0;
+
+    Display   *display = glXGetCurrentDisplay();
+    GLXContext share   = glXGetCurrentContext();
+
+    if (display && share && (C = (gl_context *) calloc(1, sizeof (gl_context))))
+    {
+        int pattr[] = { GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None };
+        int cattr[] = { GLX_FBCONFIG_ID, 0, None };
+        int n = 0;
+
+        GLXFBConfig *c;
+
+        C->display = display;
+
+        glXQueryContext(display, share, GLX_FBCONFIG_ID, cattr + 1);
+
+        if ((c = glXChooseFBConfig(display, DefaultScreen(display), cattr, &n)))
+        {
+            if (n > 0)
+            {
+                C->pbuffer = glXCreatePbuffer(display, c[0], pattr);
+                C->context = glXCreateNewContext(display, c[0], GLX_RGBA_TYPE,
+                                                 share, True);
+            }
+            XFree(c);
+        }
+
+        if (C->pbuffer && C->context)
+            return C;
+
+        if (C->context) glXDestroyContext(display, C->context);
+        if (C->pbuffer) glXDestroyPbuffer(display, C->pbuffer);
+
+        free(C);
+    }
+    return 0;
+}
+
+gl_context *gl_open_context(void)
+{
+    gl_context *C = 0;
+    Display    *display;
+
+    if ((display = XOpenDisplay(NULL)))
+    {
+        if ((C = (gl_context *) calloc(1, sizeof (gl_context))))
+        {
+            int pattr[] = { GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None };
+            int cattr[] = { GLX_DRAWABLE_TYPE, GLX_PBUFFER_BIT,
+                            GLX_RENDER_TYPE,   GLX_RGBA_BIT,
+                            GLX_RED_SIZE,      8,
+                            GLX_GREEN_SIZE,    8,
+                            GLX_BLUE_SIZE,     8, None };
+            int n = 0;
+
+            GLXFBConfig *c;
+
+            C->display = display;
+            C->own     = 1;
+
+            if ((c = glXChooseFBConfig(display, DefaultScreen(display),
+                                       cattr, &n)))
+            {
+                if (n > 0)
+                {
+                    C->pbuffer = glXCreatePbuffer(display, c[0], pattr);
+                    C->context = glXCreateNewContext(display, c[0],
+                                                     GLX_RGBA_TYPE, 0, True);
+                }
+                XFree(c);
+            }
+
+            if (C->pbuffer && C->context)
+                return C;
+
+            if (C->context) glXDestroyContext(display, C->context);
+            if (C->pbuffer) glXDestroyPbuffer(display, C->pbuffer);
+
+            free(C);
+        }
+        XCloseDisplay(display);
+    }
+    return 0;
+}
+
+void gl_bind_context(gl_context *C, int b)
+{
+    if (b)
+        glXMakeContextCurrent(C->display, C->pbuffer, C->pbuffer, C->context);
+    else
+        glXMakeContextCurrent(C->display, None, None, NULL);
+}
+
+void gl_free_context(gl_context *C)
+{
+    glXDestroyContext(C->display, C->context);
+    glXDestroyPbuffer(C->display, C->pbuffer);
+
+    if (C->own)
+        XCloseDisplay(C->display);
+
+    free(C);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// CGL shared context
+
+#ifdef __APPLE__
+
+#include <OpenGL/OpenGL.h>
+
+struct gl_context
+{
+    CGLContextObj context;
+};
+
+gl_context *gl_init_context(void)
+{
+    gl_context *C = 0;
+
+    CGLContextObj share = CGLGetCurrentContext();
+
+    if (share && (C = (gl_context *) calloc(1, sizeof (gl_context))))
+    {
+        if (CGLCreateContext(CGLGetPixelFormat(share), share,
+                             &C->context) == kCGLNoError)
+            return C;
+
+        free(C);
+    }
+    return 0;
+}
+
+// An open context chooses a pixel format of its own, allowing the software
+// renderer, and renders only to framebuffer objects, as a CGL context needs
+// no drawable.
+
+gl_context *gl_open_context(void)
+{
+    CGLPixelFormatAttribute a[] = { kCGLPFAColorSize, 24, 0 };
+    CGLPixelFormatObj       p   = 0;
+    GLint                   n   = 0;
+    gl_context             *C   = 0;
+
+    if (CGLChoosePixelFormat(a, &p, &n) == kCGLNoError && p)
+    {
+        if ((C = (gl_context *) calloc(1, sizeof (gl_context))))
+        {
+            if (CGLCreateContext(p, NULL, &C->context) != kCGLNoError)
+            {
+                free(C);
+                C = 0;
+            }
+        }
+        CGLDestroyPixelFormat(p);
+    }
+    return C;
+}
+
+void gl_bind_context(gl_context *C, int b)
+{
+    CGLSetCurrentContext(b ? C->context : NULL);
+}
+
+void gl_free_context(gl_context *C)
+{
+    CGLDestroyContext(C->context);
+    free(C);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,27 @@
+// GL-CONTEXT Copyright (C) 2011 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef GL_CONTEXT_H
+#define GL_CONTEXT_H
+
+//------------------------------------------------------------------------------
+
+typedef struct gl_context gl_context;
+
+gl_context *gl_init_context(void);
+gl_context *gl_open_context(void);
+void        gl_bind_context(gl_context *, int);
+void        gl_free_context(gl_context *);
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -45,10 +45,11 @@ static void test_framebuffer()
 
 //------------------------------------------------------------------------------
 
-static GLenum in(int c)
+static GLenum in(int c, int b)
 {
     static const GLenum i[] = { 0, GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F };
-    return i[c];
+    static const GLenum h[] = { 0, GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F };
+    return (b == 16) ? h[c] : i[c];
 }
 
 static GLenum ex(int c)
@@ -58,11 +59,11 @@ static GLenum ex(int c)
 }
 
 static void size_color(GLenum  T, GLuint  o,
-                       GLsizei w, GLsizei h, GLsizei c)
+                       GLsizei w, GLsizei h, GLsizei c, GLsizei b)
 {
     glBindTexture(T, o);
 
-    glTexImage2D(T, 0, in(c), w, h, 0, ex(c), GL_FLOAT, NULL);
+    glTexImage2D(T, 0, in(c, b), w, h, 0, ex(c), GL_FLOAT, NULL);
 
     glTexParameteri(T, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -92,7 +93,7 @@ void gl_size_framebuffer(gl_framebuffer *F, GLsizei w, GLsizei h, GLsizei c)
     {
         GLenum target = GL_TEXTURE_RECTANGLE_ARB;
     
-        size_color(target, F->color, w, h, c);
+        size_color(target, F->color, w, h, c, F->b);
 //      size_depth(target, F->depth, w, h);
     
         F->w = w;
@@ -120,10 +121,25 @@ void gl_init_framebuffer(gl_framebuffer *F, GLsizei w, GLsizei h, GLsizei c)
     F->w = 0;
     F->h = 0;
     F->c = 0;
+    F->b = 32;
 
     if (w && h && c) gl_size_framebuffer(F, w, h, c);
 }
 
+// Select 16 or 32 bits per channel. The color buffer is reallocated at the
+// next sizing.
+
+void gl_bits_framebuffer(gl_framebuffer *F, GLsizei b)
+{
+    if (F->b != b)
+    {
+        F->b = b;
+        F->w = 0;
+        F->h = 0;
+        F->c = 0;
+    }
+}
+
 void gl_free_framebuffer(gl_framebuffer *F)
 {
 //  glDeleteTextures    (1, &F->depth);
@@ -131,21 +147,173 @@ void gl_free_framebuffer(gl_framebuffer *F)
     glDeleteFramebuffers(1, &F->frame);
 }
 
+// Read the C channels of framebuffer F to buffer P, as floats.
+
+void gl_read_framebuffer(gl_framebuffer *F, GLint c, void *p)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, F->frame);
+    {
+        glReadBuffer(GL_FRONT);
+        glReadPixels(0, 0, F->w, F->h, ex(c), GL_FLOAT, p);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 void *gl_copy_framebuffer(gl_framebuffer *F, GLint c)
 {
     GLubyte *p = 0;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, F->frame);
+    if ((p = (GLubyte *) malloc(F->w * F->h * c * sizeof (GLfloat))))
+        gl_read_framebuffer(F, c, p);
+
+    return p;
+}
+
+//------------------------------------------------------------------------------
+// A pool keeps released framebuffers for reuse by any later request of the
+// same size, channel count, and precision. Idle framebuffers are freed least-
+// recently used first whenever the pool's total size exceeds its limit.
+
+struct gl_pooled
+{
+    gl_framebuffer    F;
+    struct gl_pooled *next;
+    unsigned int      time;
+    int               used;
+};
+
+typedef struct gl_pooled gl_pooled;
+
+struct gl_pool
+{
+    gl_pooled   *head;
+    size_t       max;
+    size_t       len;
+    unsigned int time;
+    unsigned int hits;
+    unsigned int misses;
+};
+
+static size_t pooled_size(const gl_pooled *P)
+{
+    return (size_t) P->F.w * P->F.h * P->F.c * P->F.b / 8;
+}
+
+// Free idle framebuffers until the pool fits its limit.
+
+static void trim_pool(gl_pool *L)
+{
+    while (L->len > L->max)
     {
-        if ((p = (GLubyte *) malloc(F->w * F->h * c * sizeof (GLfloat))))
+        gl_pooled **q = 0;
+        gl_pooled **p;
+
+        for (p = &L->head; *p; p = &(*p)->next)
+            if ((*p)->used == 0 && (q == 0 || (*p)->time < (*q)->time))
+                q = p;
+
+        if (q)
         {
-            glReadBuffer(GL_FRONT);
-            glReadPixels(0, 0, F->w, F->h, ex(c), GL_FLOAT, p);
+            gl_pooled *P = *q;
+
+            *q      = P->next;
+            L->len -= pooled_size(P);
+
+            gl_free_framebuffer(&P->F);
+            free(P);
         }
+        else break;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-    return p;
+//------------------------------------------------------------------------------
+
+gl_pool *gl_init_pool(size_t max)
+{
+    gl_pool *L;
+
+    if ((L = (gl_pool *) calloc(1, sizeof (gl_pool))))
+        L->max = max;
+
+    return L;
+}
+
+void gl_free_pool(gl_pool *L)
+{
+    gl_pooled *P;
+
+    while ((P = L->head))
+    {
+        L->head = P->next;
+        gl_free_framebuffer(&P->F);
+        free(P);
+    }
+    free(L);
+}
+
+// Set the limit of the total size of the pool, in bytes.
+
+void gl_size_pool(gl_pool *L, size_t max)
+{
+    L->max = max;
+    trim_pool(L);
+}
+
+// Report the number of requests met by a pooled framebuffer, the number that
+// required a new one, and the total size of all framebuffers in the pool.
+
+void gl_stat_pool(gl_pool *L, unsigned int *hits, unsigned int *misses,
+                              size_t       *size)
+{
+    if (hits)   *hits   = L->hits;
+    if (misses) *misses = L->misses;
+    if (size)   *size   = L->len;
+}
+
+// Return a W-by-H framebuffer with C channels of B bits each, reusing an idle
+// one if possible. Return it to the pool with gl_put_framebuffer.
+
+gl_framebuffer *gl_get_framebuffer(gl_pool *L, GLsizei w, GLsizei h,
+                                               GLsizei c, GLsizei b)
+{
+    gl_pooled *P;
+
+    for (P = L->head; P; P = P->next)
+        if (P->used == 0 && P->F.w == w && P->F.h == h
+                         && P->F.c == c && P->F.b == b)
+        {
+            P->used = 1;
+            L->hits++;
+            return &P->F;
+        }
+
+    if ((P = (gl_pooled *) calloc(1, sizeof (gl_pooled))))
+    {
+        gl_init_framebuffer(&P->F, 0, 0, c);
+        gl_bits_framebuffer(&P->F, b);
+        gl_size_framebuffer(&P->F, w, h, c);
+
+        P->used = 1;
+        P->next = L->head;
+        L->head = P;
+        L->len += pooled_size(P);
+        L->misses++;
+
+        return &P->F;
+    }
+    return 0;
+}
+
+void gl_put_framebuffer(gl_pool *L, gl_framebuffer *F)
+{
+    gl_pooled *P = (gl_pooled *) F;
+
+    if (P)
+    {
+        P->used = 0;
+        P->time = ++L->time;
+        trim_pool(L);
+    }
 }
 
 //------------------------------------------------------------------------------
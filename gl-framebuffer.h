@@ -20,6 +20,7 @@ struct gl_framebuffer
     GLsizei w;
     GLsizei h;
     GLsizei c;
+    GLsizei b;
     GLuint  frame;
     GLuint  color;
     GLuint  depth;
@@ -31,9 +32,25 @@ typedef struct gl_framebuffer gl_framebuffer;
 
 void  gl_size_framebuffer(gl_framebuffer *, GLsizei, GLsizei, GLsizei);
 void  gl_init_framebuffer(gl_framebuffer *, GLsizei, GLsizei, GLsizei);
+void  gl_bits_framebuffer(gl_framebuffer *, GLsizei);
 void  gl_free_framebuffer(gl_framebuffer *);
+void  gl_read_framebuffer(gl_framebuffer *, GLint, void *);
 void *gl_copy_framebuffer(gl_framebuffer *, GLint);
 
 //------------------------------------------------------------------------------
 
+typedef struct gl_pool gl_pool;
+
+gl_pool        *gl_init_pool(size_t);
+void            gl_free_pool(gl_pool *);
+void            gl_size_pool(gl_pool *, size_t);
+void            gl_stat_pool(gl_pool *, unsigned int *, unsigned int *,
+                                        size_t *);
+
+gl_framebuffer *gl_get_framebuffer(gl_pool *, GLsizei, GLsizei,
+                                              GLsizei, GLsizei);
+void            gl_put_framebuffer(gl_pool *, gl_framebuffer *);
+
+//------------------------------------------------------------------------------
+
 #endif
@@ -0,0 +1,330 @@
+// GL-KTX Copyright (C) 2011 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <GL/glew.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gl-ktx.h"
+
+//------------------------------------------------------------------------------
+
+// KTX 2.0 cube maps are written uncompressed with RGBA 16-bit float texels,
+// which any GL 3 implementation can upload directly. The loader also accepts
+// 32-bit float and shared-exponent texels.
+
+#define VK_FORMAT_R16G16B16A16_SFLOAT     97
+#define VK_FORMAT_R32G32B32A32_SFLOAT    109
+#define VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 123
+
+#define KTX_HEADER 80
+#define KTX_LEVEL  24
+
+static const unsigned char ktx_id[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+static const char ktx_key[] = "KTXwriter";
+static const char ktx_val[] = "lightprobe";
+
+//------------------------------------------------------------------------------
+
+// All KTX integers are little-endian, regardless of the host.
+
+static void put32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char) (v      );
+    p[1] = (unsigned char) (v >>  8);
+    p[2] = (unsigned char) (v >> 16);
+    p[3] = (unsigned char) (v >> 24);
+}
+
+static void put64(unsigned char *p, unsigned long long v)
+{
+    put32(p,     (unsigned int) (v      ));
+    put32(p + 4, (unsigned int) (v >> 32));
+}
+
+static unsigned int get32(const unsigned char *p)
+{
+    return ((unsigned int) p[0]      ) | ((unsigned int) p[1] <<  8)
+         | ((unsigned int) p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static unsigned long long get64(const unsigned char *p)
+{
+    return (unsigned long long) get32(p)
+        | ((unsigned long long) get32(p + 4) << 32);
+}
+
+static size_t align(size_t n, size_t a)
+{
+    return (n + a - 1) / a * a;
+}
+
+//------------------------------------------------------------------------------
+
+// Fill P with the basic data format descriptor of an RGBA 16-bit float texel
+// and return its length: a total size word, a 24-byte block header, and one
+// 16-byte sample for each channel.
+
+static size_t ktx_dfd(unsigned char *p)
+{
+    static const unsigned int channel[4] = { 0, 1, 2, 15 };
+
+    size_t n = 4 + 24 + 16 * 4;
+    int    i;
+
+    memset(p, 0, n);
+
+    put32(p +  0, (unsigned int) n);
+    put32(p +  4, 0);                     // vendor and descriptor type
+    put32(p +  8, 2 | ((n - 4) << 16));   // version and block size
+    put32(p + 12, 1 | (1 << 8) | (1 << 16)); // RGBSDA, BT709, linear
+    put32(p + 16, 0);                     // texel block dimensions
+    put32(p + 20, 8);                     // bytes per plane
+
+    for (i = 0; i < 4; i++)
+    {
+        unsigned char *s = p + 28 + 16 * i;
+
+        put32(s +  0, (16 * i) | (15 << 16) | ((channel[i] | 0xC0) << 24));
+        put32(s +  4, 0);
+        put32(s +  8, 0xBF800000);        // -1.0
+        put32(s + 12, 0x3F800000);        // +1.0
+    }
+    return n;
+}
+
+// Fill P with the key/value data naming the writer and return its length.
+
+static size_t ktx_kvd(unsigned char *p)
+{
+    size_t k = sizeof (ktx_key);
+    size_t v = sizeof (ktx_val);
+    size_t n = align(4 + k + v, 4);
+
+    memset(p, 0, n);
+
+    put32(p, (unsigned int) (k + v));
+    memcpy(p + 4,     ktx_key, k);
+    memcpy(p + 4 + k, ktx_val, v);
+
+    return n;
+}
+
+//------------------------------------------------------------------------------
+
+// Write the N levels of cube map texture O, with S-by-S base, to a KTX 2.0 file
+// at the named path. Level data is stored smallest first, as the format
+// requires, with the six faces of each level contiguous in GL order. Return
+// nonzero on success.
+
+int gl_save_ktx(const char *path, GLuint o, GLsizei s, GLint n)
+{
+    const size_t t = 8;
+
+    unsigned char head[KTX_HEADER];
+    unsigned char dfd[128];
+    unsigned char kvd[64];
+    unsigned char *index = 0;
+    unsigned char *data  = 0;
+
+    size_t dfd_n = ktx_dfd(dfd);
+    size_t kvd_n = ktx_kvd(kvd);
+    size_t off;
+    size_t pad;
+
+    FILE  *fp;
+    GLint  l;
+    int    k;
+    int    r = 0;
+
+    if ((index = (unsigned char *) calloc(n, KTX_LEVEL)) == NULL)
+        return 0;
+
+    // Lay out the file: header, level index, DFD, KVD, and then the levels.
+
+    off = KTX_HEADER + n * KTX_LEVEL + dfd_n + kvd_n;
+    pad = align(off, t) - off;
+    off = off + pad;
+
+    for (l = n - 1; l >= 0; l--)
+    {
+        const size_t m = (s >> l) ? (s >> l) : 1;
+        const size_t b = 6 * m * m * t;
+
+        put64(index + l * KTX_LEVEL,      off);
+        put64(index + l * KTX_LEVEL +  8, b);
+        put64(index + l * KTX_LEVEL + 16, b);
+
+        off = align(off + b, t);
+    }
+
+    memset(head, 0, KTX_HEADER);
+    memcpy(head, ktx_id, sizeof (ktx_id));
+
+    put32(head + 12, VK_FORMAT_R16G16B16A16_SFLOAT);
+    put32(head + 16, 2);                  // type size
+    put32(head + 20, (unsigned int) s);   // width
+    put32(head + 24, (unsigned int) s);   // height
+    put32(head + 28, 0);                  // depth
+    put32(head + 32, 0);                  // layers
+    put32(head + 36, 6);                  // faces
+    put32(head + 40, (unsigned int) n);   // levels
+    put32(head + 44, 0);                  // supercompression
+    put32(head + 48, (unsigned int) (KTX_HEADER + n * KTX_LEVEL));
+    put32(head + 52, (unsigned int) (dfd_n));
+    put32(head + 56, (unsigned int) (KTX_HEADER + n * KTX_LEVEL + dfd_n));
+    put32(head + 60, (unsigned int) (kvd_n));
+    put64(head + 64, 0);                  // supercompression global data
+    put64(head + 72, 0);
+
+    // Write the header and read back and write each level.
+
+    if ((fp = fopen(path, "wb")))
+    {
+        static const unsigned char zero[8] = { 0 };
+
+        fwrite(head,  1, KTX_HEADER,     fp);
+        fwrite(index, 1, n * KTX_LEVEL,  fp);
+        fwrite(dfd,   1, dfd_n,          fp);
+        fwrite(kvd,   1, kvd_n,          fp);
+        fwrite(zero,  1, pad,            fp);
+
+        if ((data = (unsigned char *) malloc(s * s * t)))
+        {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, o);
+
+            for (l = n - 1; l >= 0; l--)
+            {
+                const size_t m = (s >> l) ? (s >> l) : 1;
+
+                for (k = 0; k < 6; k++)
+                {
+                    glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, l,
+                                  GL_RGBA, GL_HALF_FLOAT, data);
+                    fwrite(data, 1, m * m * t, fp);
+                }
+            }
+            free(data);
+            r = 1;
+        }
+        fclose(fp);
+    }
+    free(index);
+    return r;
+}
+
+//------------------------------------------------------------------------------
+
+// Read the named KTX 2.0 cube map and upload each of its levels directly to a
+// new cube map texture. Return the texture, or zero on failure.
+
+GLuint gl_load_ktx(const char *path)
+{
+    const GLenum T = GL_TEXTURE_CUBE_MAP;
+
+    unsigned char *p = 0;
+    long           n = 0;
+    GLuint         o = 0;
+    FILE          *fp;
+
+    if ((fp = fopen(path, "rb")))
+    {
+        if (fseek(fp, 0, SEEK_END) == 0 && (n = ftell(fp)) > KTX_HEADER)
+            if ((p = (unsigned char *) malloc(n)))
+            {
+                rewind(fp);
+
+                if (fread(p, 1, n, fp) != (size_t) n)
+                {
+                    free(p);
+                    p = 0;
+                }
+            }
+        fclose(fp);
+    }
+
+    if (p && memcmp(p, ktx_id, sizeof (ktx_id)) == 0 && get32(p + 36) == 6
+          && get32(p + 44) == 0)
+    {
+        const unsigned int vk = get32(p + 12);
+        const unsigned int s  = get32(p + 20);
+        const unsigned int c  = get32(p + 40) ? get32(p + 40) : 1;
+
+        GLenum i = 0;
+        GLenum e = 0;
+        GLenum t = 0;
+        size_t b = 0;
+
+        switch (vk)
+        {
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            i = GL_RGBA16F;
+            e = GL_RGBA;
+            t = GL_HALF_FLOAT;
+            b = 8;
+            break;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            i = GL_RGBA32F;
+            e = GL_RGBA;
+            t = GL_FLOAT;
+            b = 16;
+            break;
+        case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+            i = GL_RGB9_E5;
+            e = GL_RGB;
+            t = GL_UNSIGNED_INT_5_9_9_9_REV;
+            b = 4;
+            break;
+        }
+
+        if (b && (size_t) n >= KTX_HEADER + c * KTX_LEVEL)
+        {
+            unsigned int l;
+            int          k;
+
+            glGenTextures(1, &o);
+            glBindTexture(T,  o);
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+            for (l = 0; l < c; l++)
+            {
+                const unsigned long long off = get64(p + KTX_HEADER
+                                                       + l * KTX_LEVEL);
+                const size_t             m   = (s >> l) ? (s >> l) : 1;
+
+                if (off + 6 * m * m * b <= (unsigned long long) n)
+                    for (k = 0; k < 6; k++)
+                        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, l, i,
+                                     m, m, 0, e, t, p + off + k * m * m * b);
+            }
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+            glTexParameteri(T, GL_TEXTURE_MIN_FILTER, (c > 1) ?
+                               GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(T, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+            glTexParameteri(T, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+            glTexParameteri(T, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+            glTexParameteri(T, GL_TEXTURE_MAX_LEVEL,  c - 1);
+        }
+    }
+    free(p);
+    return o;
+}
+
+//------------------------------------------------------------------------------
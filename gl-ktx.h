@@ -0,0 +1,23 @@
+// GL-KTX Copyright (C) 2011 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef GL_KTX_H
+#define GL_KTX_H
+
+//------------------------------------------------------------------------------
+
+int    gl_save_ktx(const char *, GLuint, GLsizei, GLint);
+GLuint gl_load_ktx(const char *);
+
+//------------------------------------------------------------------------------
+
+#endif
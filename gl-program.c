@@ -112,10 +112,12 @@ GLuint gl_load_fshader(const unsigned char *str, unsigned int len)
     return load_shader(GL_FRAGMENT_SHADER, str, len);
 }
 
-// Receive vertex and fragment shader objects. Link these into a GLSL program
-// object, checking logs and reporting any errors. Return 0 on failure.
+// Receive vertex and fragment shader objects, and an optional library shader
+// object defining functions that the others declare. Link these into a GLSL
+// program object, checking logs and reporting any errors. Return 0 on failure.
 
-GLuint gl_load_program(GLuint vert_shader, GLuint frag_shader)
+static GLuint link_program(GLuint vert_shader, GLuint frag_shader,
+                                               GLuint lib_shader)
 {
     if (vert_shader && frag_shader)
     {
@@ -126,6 +128,9 @@ GLuint gl_load_program(GLuint vert_shader, GLuint frag_shader)
         glAttachShader(program, vert_shader);
         glAttachShader(program, frag_shader);
 
+        if (lib_shader)
+            glAttachShader(program, lib_shader);
+
         glLinkProgram(program);
 
         // If the program is valid, return it.  Else, delete it.
@@ -138,6 +143,11 @@ GLuint gl_load_program(GLuint vert_shader, GLuint frag_shader)
     return 0;
 }
 
+GLuint gl_load_program(GLuint vert_shader, GLuint frag_shader)
+{
+    return link_program(vert_shader, frag_shader, 0);
+}
+
 //------------------------------------------------------------------------------
 
 void gl_init_program(gl_program *P,
@@ -150,6 +160,20 @@ void gl_init_program(gl_program *P,
     P->program = gl_load_program(P->vshader, P->fshader);
 }
 
+// Initialize a program whose fragment shader calls functions of the given
+// library, a fragment shader object shared among programs and owned by the
+// caller.
+
+void gl_init_library(gl_program *P,
+                     const unsigned char *vstr, unsigned int vlen,
+                     const unsigned char *fstr, unsigned int flen, GLuint lib)
+{
+    P->vshader = gl_load_vshader(vstr, vlen);
+    P->fshader = gl_load_fshader(fstr, flen);
+
+    P->program = lib ? link_program(P->vshader, P->fshader, lib) : 0;
+}
+
 void gl_free_program(gl_program *P)
 {
     glDeleteProgram(P->program);
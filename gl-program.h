@@ -35,6 +35,8 @@ GLuint gl_load_program(GLuint, GLuint);
 
 void gl_init_program(gl_program *, const unsigned char *, unsigned int,
                                    const unsigned char *, unsigned int);
+void gl_init_library(gl_program *, const unsigned char *, unsigned int,
+                                   const unsigned char *, unsigned int, GLuint);
 void gl_free_program(gl_program *);
 
 //------------------------------------------------------------------------------
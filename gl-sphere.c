@@ -142,6 +142,26 @@ static void init_line(int r, int c)
     }
 }
 
+// Set the currently-bound vertex array buffer object to the octahedral map of
+// the sphere. This is the square [-1, 1] in the plane, followed by the lines of
+// the border, the equator diamond, and the cross of the meridians.
+
+static void init_octa(void)
+{
+    static const GLfloat v[24][2] = {
+        { -1, -1 }, {  1, -1 }, {  1,  1 }, { -1,  1 },
+
+        { -1, -1 }, {  1, -1 }, {  1, -1 }, {  1,  1 },
+        {  1,  1 }, { -1,  1 }, { -1,  1 }, { -1, -1 },
+
+        {  0, -1 }, {  1,  0 }, {  1,  0 }, {  0,  1 },
+        {  0,  1 }, { -1,  0 }, { -1,  0 }, {  0, -1 },
+
+        { -1,  0 }, {  1,  0 }, {  0, -1 }, {  0,  1 },
+    };
+    glBufferData(GL_ARRAY_BUFFER, sizeof (v), v, GL_STATIC_DRAW);
+}
+
 // Initialize the OpenGL resources needed for rendering a spherical mesh with R
 // rows and C columns.
 
@@ -155,6 +175,7 @@ void gl_init_sphere(gl_sphere *p, int r, int c)
     glGenBuffers(1, &p->vert_buf);
     glGenBuffers(1, &p->quad_buf);
     glGenBuffers(1, &p->line_buf);
+    glGenBuffers(1, &p->octa_buf);
 
     // Compute the buffer sizes.
 
@@ -180,6 +201,11 @@ void gl_init_sphere(gl_sphere *p, int r, int c)
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, ln, 0, GL_STATIC_DRAW);
     init_line(r, c);
 
+    // Initialize the octahedral map.
+
+    glBindBuffer(GL_ARRAY_BUFFER,         p->octa_buf);
+    init_octa();
+
     // Don't leak the array buffer state.
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -190,6 +216,7 @@ void gl_init_sphere(gl_sphere *p, int r, int c)
 
 void gl_free_sphere(gl_sphere *p)
 {
+    glDeleteBuffers(1, &p->octa_buf);
     glDeleteBuffers(1, &p->line_buf);
     glDeleteBuffers(1, &p->quad_buf);
     glDeleteBuffers(1, &p->vert_buf);
@@ -223,9 +250,26 @@ static void draw(GLuint eb, GLenum  mode, GLsizei num,
     glBindBuffer(GL_ARRAY_BUFFER,         0);
 }
 
+// Render vertices FIRST through FIRST + NUM of the octahedral map vertex buffer
+// VB as primitive type MODE.
+
+static void draw_octa(GLuint vb, GLenum mode, GLint first, GLsizei num)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vb);
+    {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        {
+            glVertexPointer(2, GL_FLOAT, 0, 0);
+            glDrawArrays(mode, first, num);
+        }
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 // Render the sphere using filled quads or lines, projecting it as a 3D globe,
-// 2D chart, or 2D polar map. Choose the paramaters for the desired output and
-// let the above draw function do the work.
+// 2D chart, 2D polar map, or 2D octahedral map. Choose the paramaters for the
+// desired output and let the above draw functions do the work.
 
 void gl_fill_sphere(const gl_sphere *p, int m)
 {
@@ -236,9 +280,13 @@ void gl_fill_sphere(const gl_sphere *p, int m)
         (GLvoid *) offsetof (vert, polar_pos),
     };
 
-    assert(0 <= m && m < 3);
+    assert(0 <= m && m < 4);
 
-    draw(p->quad_buf, GL_QUADS, 4 * p->r * p->c, p->vert_buf, s[m], o[m]);
+    if (m == GL_SPHERE_OCTA)
+        draw_octa(p->octa_buf, GL_QUADS, 0, 4);
+    else
+        draw(p->quad_buf, GL_QUADS, 4 * p->r * p->c,
+             p->vert_buf, s[m], o[m]);
 }
 
 void gl_line_sphere(const gl_sphere *p, int m)
@@ -250,9 +298,13 @@ void gl_line_sphere(const gl_sphere *p, int m)
         (GLvoid *) offsetof (vert, polar_pos),
     };
 
-    assert(0 <= m && m < 3);
+    assert(0 <= m && m < 4);
 
-    draw(p->line_buf, GL_LINES, 8 * p->r + 2 * p->c, p->vert_buf, s[m], o[m]);
+    if (m == GL_SPHERE_OCTA)
+        draw_octa(p->octa_buf, GL_LINES, 4, 20);
+    else
+        draw(p->line_buf, GL_LINES, 8 * p->r + 2 * p->c,
+             p->vert_buf, s[m], o[m]);
 }
 
 //------------------------------------------------------------------------------
@@ -23,6 +23,7 @@ struct gl_sphere
     GLuint  vert_buf;
     GLuint  quad_buf;
     GLuint  line_buf;
+    GLuint  octa_buf;
 };
 
 typedef struct gl_sphere gl_sphere;
@@ -34,6 +35,7 @@ enum
     GL_SPHERE_GLOBE,
     GL_SPHERE_CHART,
     GL_SPHERE_POLAR,
+    GL_SPHERE_OCTA,
 };
 
 void gl_init_sphere(gl_sphere *, int, int);
@@ -0,0 +1,236 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+// Export every project in a directory, headless, and report the throughput.
+// Each export is written beside its project, named as the project with the
+// type and extension of the output, so as not to collide with its sources.
+//
+// Given a frame range, export a sequence instead: a template project, whose
+// source paths are patterns numbered by frame, and the pattern of the output.
+// Frames already written are skipped, so a sequence resumes where it stopped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "lp-render.h"
+
+//------------------------------------------------------------------------------
+
+struct output
+{
+    const char *name;
+    int         f;
+    const char *ext;
+};
+
+static const struct output outputs[] = {
+    { "chart",   LP_RENDER_CHART,                  ".tif" },
+    { "polar",   LP_RENDER_POLAR,                  ".tif" },
+    { "octa",    LP_RENDER_OCTA,                   ".tif" },
+    { "cube",    LP_RENDER_CUBE,                   ".tif" },
+    { "ggx",     LP_RENDER_CUBE  | LP_RENDER_GGX,  ".tif" },
+    { "ktx",     LP_RENDER_CUBE  | LP_RENDER_KTX,  ".ktx" },
+    { "sh9",     LP_RENDER_SH9,                    ".txt" },
+    { "sh16",    LP_RENDER_SH16,                   ".txt" },
+    { "preview", LP_RENDER_CHART | LP_RENDER_LDR,  ".tif" },
+    { "cdf",     LP_RENDER_CHART | LP_RENDER_CDF,  ".tif" },
+};
+
+// Return true if the named file is a project: a binary project, by its
+// identifier, or a text project, by its extension.
+
+static int is_project(const char *path)
+{
+    static const unsigned char id[8] = {
+        0x89, 0x4C, 0x50, 0x52, 0x0D, 0x0A, 0x1A, 0x0A
+    };
+
+    const size_t  n = strlen(path);
+    unsigned char b[8];
+    FILE         *F;
+    int           r = 0;
+
+    if (n > 4 && strcmp(path + n - 4, ".dat") == 0)
+        return 1;
+
+    if ((F = fopen(path, "rb")))
+    {
+        r = (fread(b, 1, 8, F) == 8 && memcmp(b, id, 8) == 0);
+        fclose(F);
+    }
+    return r;
+}
+
+static void usage(const char *name)
+{
+    size_t i;
+
+    fprintf(stderr, "usage: %s [-n threads] [-m megabytes] [-s size] "
+                    "[-t type] directory\n", name);
+    fprintf(stderr, "       %s [-n threads] [-m megabytes] [-s size] "
+                    "[-t type] -f first -l last template output\n", name);
+    fprintf(stderr, "types:");
+
+    for (i = 0; i < sizeof (outputs) / sizeof (outputs[0]); i++)
+        fprintf(stderr, " %s", outputs[i].name);
+
+    fprintf(stderr, "\n");
+}
+
+// Queue each project in directory DIR. Return the number queued, or -1 if the
+// directory could not be read.
+
+static int directory(lp_batch *B, const char *dir, const struct output *o,
+                                                   int s)
+{
+    struct dirent *e;
+    DIR           *D;
+    int            q = 0;
+
+    if ((D = opendir(dir)) == 0)
+    {
+        perror(dir);
+        return -1;
+    }
+
+    while ((e = readdir(D)))
+    {
+        const size_t z = strlen(dir)     + strlen(e->d_name)
+                       + strlen(o->name) + strlen(o->ext) + 3;
+        char *in;
+        char *out;
+
+        if (e->d_name[0] == '.')
+            continue;
+
+        if ((in  = (char *) malloc(z)) &&
+            (out = (char *) malloc(z)))
+        {
+            char *x;
+
+            sprintf(in,  "%s/%s", dir, e->d_name);
+            strcpy (out, in);
+
+            if ((x = strrchr(out, '.')) && x > strrchr(out, '/') + 1)
+                *x = 0;
+
+            strcat(out, "-");
+            strcat(out, o->name);
+            strcat(out, o->ext);
+
+            if (is_project(in) && lp_batch_add(B, in, o->f | LP_RENDER_ALL,
+                                               s, out))
+                q++;
+
+            free(out);
+        }
+        free(in);
+    }
+    closedir(D);
+
+    return q;
+}
+
+int main(int argc, char *argv[])
+{
+    const struct output *o = outputs;
+
+    lp_batch_stats S;
+    lp_batch      *B;
+
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    int  m = 1024;
+    int  s = 1024;
+    int  a = 0;
+    int  b = -1;
+    int  c;
+    int  q = 0;
+
+    while ((c = getopt(argc, argv, "n:m:s:t:f:l:")) != -1)
+    {
+        size_t i;
+
+        switch (c)
+        {
+        case 'n': n = atol(optarg);                    break;
+        case 'm': m = atoi(optarg);                    break;
+        case 's': s = atoi(optarg);                    break;
+        case 'f': a = atoi(optarg);                    break;
+        case 'l': b = atoi(optarg);                    break;
+        case 't':
+            for (o = 0, i = 0; i < sizeof (outputs) / sizeof (outputs[0]); i++)
+                if (strcmp(optarg, outputs[i].name) == 0)
+                    o = outputs + i;
+            if (o == 0)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - (b < 0 ? 1 : 2) || s < 1 || (b >= 0 && b < a))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if ((B = lp_batch_init((int) n, m)) == 0)
+    {
+        fprintf(stderr, "%s: no offscreen GL context\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Queue each project in the directory, or each frame not yet written.
+
+    if (b < 0)
+        q = directory(B, argv[optind], o, s);
+
+    else if ((q = lp_batch_sequence(B, argv[optind], a, b,
+                                    o->f | LP_RENDER_ALL, s,
+                                    argv[optind + 1])) >= 0)
+        printf("%d of %d frames to do\n", q, b - a + 1);
+
+    if (q < 0)
+    {
+        lp_batch_free(B);
+        return EXIT_FAILURE;
+    }
+
+    // Wait for all, and report.
+
+    lp_batch_wait(B, &S);
+    lp_batch_free(B);
+
+    if (b < 0)
+        printf("%d of %d projects in %.2f s: %.2f projects/s, %.1f Mpixel/s\n",
+               S.done, q, S.seconds, S.done / S.seconds,
+                                     S.pixels / S.seconds / 1e6);
+    else
+        printf("%d of %d frames in %.2f s: %.2f frames/s, %.2f sustained\n",
+               S.done, q, S.seconds, S.done / S.seconds,
+               S.steady > 0.0 ? (S.done - 1) / S.steady : 0.0);
+
+    printf("busy: decode %.2f s, render %.2f s, encode %.2f s\n",
+           S.decode, S.render, S.encode);
+
+    return S.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,1071 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+// A batch runs many exports, each of one project, through three stages with
+// threads of their own. Decoders parse a project and decode its source images.
+// Renderers each own an independent GL context and lightprobe, and blend and
+// read back the export. Encoders write the result. Each stage works on another
+// job at once, and the memory budget bounds the decoded input and read-back
+// output held between them.
+//
+// A sequence is a series of such jobs, one per frame of a time-lapse from a
+// fixed rig. A template project gives the alignment of each image, and its
+// source paths, like the output path, are patterns numbered by frame. Each
+// renderer keeps the images of its last frame, so that the next frame swaps in
+// its own pixels and reuses their warp maps. Outputs are written under a
+// temporary name and renamed once whole, so an output that exists is complete,
+// and a sequence resumes by skipping the frames already written.
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "lp-render.h"
+#include "lp-project.h"
+#include "gl-context.h"
+
+//------------------------------------------------------------------------------
+
+// Threads per stage at most, and images per project, as a lightprobe holds.
+
+#define BATCH_MAX    64
+#define BATCH_IMAGES 8
+
+// Each image carries its values and then its exposure, as projects store them.
+
+#define BATCH_VALUES (LP_MAX_VALUE + 1)
+
+// A decoded source image, with its values.
+
+struct batch_image
+{
+    void  *p;
+    int    w;
+    int    h;
+    int    c;
+    int    t;
+    float  values[BATCH_VALUES];
+};
+
+typedef struct batch_image batch_image;
+
+// A sequence template gives the source path pattern and values of each image.
+
+struct batch_template
+{
+    struct batch_template *next;
+
+    char  *project;
+    char  *paths[BATCH_IMAGES];
+    float  values[BATCH_IMAGES][BATCH_VALUES];
+    int    n;
+};
+
+typedef struct batch_template batch_template;
+
+// A read-back page of an export, with the geometry of the whole page.
+
+struct batch_page
+{
+    struct batch_page *next;
+    lp_tile            tile;
+    char              *p;
+};
+
+typedef struct batch_page batch_page;
+
+// A job moves from queue to queue as each stage completes it. Its size is the
+// memory it holds against the batch budget.
+
+struct batch_job
+{
+    struct batch_job *next;
+
+    char        *project;
+    char        *path;
+    int          f;
+    int          s;
+
+    const batch_template *T;
+    int                   frame;
+
+    batch_image  images[BATCH_IMAGES];
+    int          n;
+    batch_page  *pages;
+    batch_page  *last;
+    size_t       z;
+    double       pixels;
+    int          failed;
+};
+
+typedef struct batch_job batch_job;
+
+struct batch_queue
+{
+    batch_job *head;
+    batch_job *tail;
+};
+
+typedef struct batch_queue batch_queue;
+
+struct lp_batch
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    pthread_t       threads[3 * BATCH_MAX];
+    int             threadn;
+    int             n;
+    int             ready;
+    int             ok;
+    int             quit;
+
+    batch_queue     decode;
+    batch_queue     render;
+    batch_queue     encode;
+    int             pending;
+
+    size_t          budget;
+    size_t          used;
+
+    batch_template *templates;
+
+    lp_batch_stats  stats;
+    double          start;
+    double          first;
+};
+
+//------------------------------------------------------------------------------
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void push(batch_queue *Q, batch_job *J)
+{
+    J->next = 0;
+
+    if (Q->tail)
+        Q->tail->next = J;
+    else
+        Q->head       = J;
+
+    Q->tail = J;
+}
+
+static batch_job *pop(batch_queue *Q)
+{
+    batch_job *J;
+
+    if ((J = Q->head))
+    {
+        if ((Q->head = J->next) == 0)
+            Q->tail = 0;
+
+        J->next = 0;
+    }
+    return J;
+}
+
+// Wait for a job on queue Q, holding the batch mutex. Return null on quit.
+
+static batch_job *wait_job(lp_batch *B, batch_queue *Q)
+{
+    while (Q->head == 0 && !B->quit)
+        pthread_cond_wait(&B->cond, &B->mutex);
+
+    return B->quit ? 0 : pop(Q);
+}
+
+static void free_job(batch_job *J)
+{
+    batch_page *P;
+    int         k;
+
+    while ((P = J->pages))
+    {
+        J->pages = P->next;
+        free(P->p);
+        free(P);
+    }
+    for (k = 0; k < J->n; k++)
+        free(J->images[k].p);
+
+    free(J->project);
+    free(J->path);
+    free(J);
+}
+
+// Release a job's memory from the budget and count it done.
+
+static void finish(lp_batch *B, batch_job *J)
+{
+    pthread_mutex_lock(&B->mutex);
+    {
+        if (J->failed)
+        {
+            fprintf(stderr, "%s failed\n", J->T ? J->path : J->project);
+            B->stats.failed++;
+        }
+        else
+        {
+            // Steady time runs from the first export done to the last.
+
+            if (B->stats.done++ == 0)
+                B->first = now();
+
+            B->stats.steady  = now() - B->first;
+            B->stats.pixels += J->pixels;
+        }
+        B->used -= J->z;
+        B->pending--;
+
+        pthread_cond_broadcast(&B->cond);
+    }
+    pthread_mutex_unlock(&B->mutex);
+
+    free_job(J);
+}
+
+//------------------------------------------------------------------------------
+
+// Return the bytes per sample of sample type T.
+
+static int type_size(int t)
+{
+    if      (t == LP_TYPE_UBYTE  || t == LP_TYPE_BYTE)  return 1;
+    else if (t == LP_TYPE_USHORT || t == LP_TYPE_SHORT
+                                 || t == LP_TYPE_HALF)  return 2;
+    else                                                return 4;
+}
+
+// Each image of a project is given to a function, with its source path and its
+// values, which returns false to stop.
+
+typedef int (*entry_fn)(void *, const char *, const float *, int);
+
+// Add an image of the named source to a job, resolving a relative path against
+// the directory of the project.
+
+static int add_source(void *data, const char *path, const float *v, int n)
+{
+    batch_job   *J = (batch_job *) data;
+    batch_image *I = J->images + J->n;
+    const char  *s = strrchr(J->project, '/');
+    char        *p = 0;
+    int          k;
+
+    if (J->n == BATCH_IMAGES)
+        return 0;
+
+    if (path[0] != '/' && s)
+    {
+        const size_t d = (size_t) (s - J->project) + 1;
+
+        if ((p = (char *) malloc(d + strlen(path) + 1)))
+        {
+            memcpy(p, J->project, d);
+            strcpy(p + d, path);
+            path = p;
+        }
+    }
+
+    if ((I->p = lp_read_image(path, &I->w, &I->h, &I->c, &I->t)))
+    {
+        for (k = 0; k < n && k < BATCH_VALUES; k++)
+            I->values[k] = v[k];
+
+        J->z += (size_t) I->w * I->h * I->c * type_size(I->t);
+        J->n++;
+    }
+    else fprintf(stderr, "%s could not be read\n", path);
+
+    free(p);
+    return (I->p != 0);
+}
+
+// Read a text project: one image per line, giving the circle position and
+// radius, the sphere elevation, azimuth, and roll, and the quoted path.
+
+static int read_text(const char *project, entry_fn fn, void *data)
+{
+    char  line[4096];
+    FILE *F;
+    int   r = 0;
+
+    if ((F = fopen(project, "r")))
+    {
+        r = 1;
+
+        while (r && fgets(line, sizeof (line), F))
+        {
+            float v[6];
+            char *p;
+            char *q;
+            int   n = 0;
+
+            if (sscanf(line, "%f %f %f %f %f %f %n", v + 0, v + 1, v + 2,
+                                                     v + 3, v + 4, v + 5,
+                                                     &n) < 6)
+                continue;
+
+            // Unquote the path in place.
+
+            if (*(p = line + n) == '"')
+            {
+                for (q = ++p; *p && *p != '"'; p++, q++)
+                {
+                    if (*p == '\\' && p[1])
+                        p++;
+                    *q = *p;
+                }
+                *q = 0;
+                p  = line + n + 1;
+            }
+            else
+                p[strcspn(p, "\r\n")] = 0;
+
+            r = fn(data, p, v, 6);
+        }
+        fclose(F);
+    }
+    return r;
+}
+
+// Read a project, binary or text, giving each image to FN.
+
+static int read_project(const char *project, entry_fn fn, void *data)
+{
+    project_entry *e;
+    int            k;
+    int            n;
+    int            r = 1;
+
+    if ((e = project_load(project, &n)))
+    {
+        for (k = 0; r && k < n; k++)
+        {
+            if (e[k].path[0])
+                r = fn(data, e[k].path, e[k].values, e[k].valuen);
+            else
+                fprintf(stderr, "%s: merged image has no source\n", project);
+        }
+        project_free(e, n);
+        return r;
+    }
+    if (n < 0)
+        return read_text(project, fn, data);
+
+    return 0;
+}
+
+// Return the number of integer conversions in path pattern P, or -1 if it has
+// any other. A literal percent sign is written twice.
+
+static int pattern_count(const char *p)
+{
+    int n = 0;
+
+    while ((p = strchr(p, '%')))
+    {
+        if (*++p == '%')
+        {
+            p++;
+            continue;
+        }
+        p += strspn(p, "-+ 0#");
+        p += strspn(p, "0123456789");
+
+        if (*p == 'd' || *p == 'i')
+            n++;
+        else
+            return -1;
+    }
+    return n;
+}
+
+// Return a new path formed from pattern P and frame K.
+
+static char *frame_path(const char *p, int k)
+{
+    const int n = snprintf(0, 0, p, k);
+    char     *q;
+
+    if (n >= 0 && (q = (char *) malloc((size_t) n + 1)))
+    {
+        snprintf(q, (size_t) n + 1, p, k);
+        return q;
+    }
+    return 0;
+}
+
+// Decode the images of a frame of a sequence, numbering its template's paths.
+
+static int load_frame(batch_job *J)
+{
+    const batch_template *T = J->T;
+
+    char *p;
+    int   k;
+    int   r = 1;
+
+    for (k = 0; r && k < T->n; k++)
+        if ((r = ((p = frame_path(T->paths[k], J->frame)) != 0)))
+        {
+            r = add_source(J, p, T->values[k], BATCH_VALUES);
+            free(p);
+        }
+
+    return r;
+}
+
+// Parse a job's project and decode its images.
+
+static int load_job(batch_job *J)
+{
+    if (J->T)
+        return load_frame(J);
+    else
+        return read_project(J->project, add_source, J);
+}
+
+static void *decoder(void *p)
+{
+    lp_batch  *B = (lp_batch *) p;
+    batch_job *J;
+
+    pthread_mutex_lock(&B->mutex);
+
+    while ((J = wait_job(B, &B->decode)))
+    {
+        double t;
+
+        // Wait for the budget to allow another job to be held.
+
+        while (B->budget && B->used >= B->budget && B->used > 0 && !B->quit)
+            pthread_cond_wait(&B->cond, &B->mutex);
+
+        pthread_mutex_unlock(&B->mutex);
+        {
+            t = now();
+            J->failed = !load_job(J) || J->n == 0;
+            t = now() - t;
+        }
+        pthread_mutex_lock(&B->mutex);
+
+        B->stats.decode += t;
+        B->used         += J->z;
+
+        if (J->failed)
+        {
+            pthread_mutex_unlock(&B->mutex);
+            finish(B, J);
+            pthread_mutex_lock(&B->mutex);
+        }
+        else
+        {
+            push(&B->render, J);
+            pthread_cond_broadcast(&B->cond);
+        }
+    }
+
+    pthread_mutex_unlock(&B->mutex);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+// Gather read-back tiles into whole pages, charging them to the budget.
+
+static void gather(const lp_tile *t, void *data)
+{
+    batch_job  *J = (batch_job *) data;
+    batch_page *P = J->last;
+
+    if (t->y == 0)
+    {
+        if ((P = (batch_page *) calloc(1, sizeof (batch_page))) &&
+            (P->p = (char *) malloc((size_t) t->stride * t->height)))
+        {
+            P->tile   = *t;
+            P->tile.h = t->height;
+
+            if (J->last)
+                J->last->next = P;
+            else
+                J->pages      = P;
+
+            J->last    = P;
+            J->z      += (size_t) t->stride * t->height;
+            J->pixels += (double) t->width * t->height;
+        }
+        else
+        {
+            free(P);
+            J->failed = 1;
+            P         = 0;
+        }
+    }
+
+    if (P && !J->failed)
+        memcpy(P->p + (size_t) t->y * t->stride, t->p,
+                      (size_t) t->h * t->stride);
+}
+
+// Return a new string of A followed by B.
+
+static char *suffix(const char *a, const char *b)
+{
+    char *p;
+
+    if ((p = (char *) malloc(strlen(a) + strlen(b) + 1)))
+    {
+        strcpy(p, a);
+        strcat(p, b);
+    }
+    return p;
+}
+
+// A renderer holds the images of the last frame of a sequence it rendered, with
+// their indices, until it renders another job.
+
+struct batch_held
+{
+    const batch_template *T;
+    int                   d[BATCH_IMAGES];
+    int                   n;
+};
+
+typedef struct batch_held batch_held;
+
+static void release(lightprobe *L, batch_held *H)
+{
+    int k;
+
+    for (k = 0; k < BATCH_IMAGES; k++)
+        lp_del_image(L, k);
+
+    H->T = 0;
+    H->n = 0;
+}
+
+// Write an export directly, as lp_export would, under a temporary name, along
+// with any sampling table. Return true if it was written.
+
+static int write_job(lightprobe *L, batch_job *J)
+{
+    char *p;
+    char *q = 0;
+    char *r = 0;
+    int   ok = 0;
+
+    if ((p = suffix(J->path, ".part")))
+    {
+        lp_export(L, J->f, J->s, p);
+
+        if ((J->f & LP_RENDER_CDF) && (q = suffix(p,       ".cdf"))
+                                   && (r = suffix(J->path, ".cdf")))
+            rename(q, r);
+
+        if ((ok = (rename(p, J->path) == 0)) == 0)
+            remove(p);
+    }
+    free(r);
+    free(q);
+    free(p);
+    return ok;
+}
+
+// Add a job's images to lightprobe L, render its export, and remove them. The
+// images are handed over without copying. Exports that are not pixels, KTX
+// containers, and charts with sampling tables are written here rather than by
+// an encoder. A frame of the sequence that L holds swaps its images in, and
+// leaves them held for the next.
+
+static void render_job(lightprobe *L, batch_held *H, batch_job *J)
+{
+    int d[BATCH_IMAGES];
+    int i;
+    int k;
+
+    if (H->T && H->T != J->T)
+        release(L, H);
+
+    for (k = 0; k < J->n; k++)
+    {
+        batch_image *I = J->images + k;
+
+        if (k < H->n)
+            d[k] = lp_swap_image_data(L, H->d[k], I->p, I->w, I->h, I->c,
+                                      I->t, 0, free, I->p);
+        else
+            d[k] = lp_add_image_data (L,          I->p, I->w, I->h, I->c,
+                                      I->t, 0, free, I->p);
+
+        if (d[k] >= 0)
+        {
+            lp_sel_image(L, d[k]);
+
+            for (i = 0; i < LP_MAX_VALUE; i++)
+                lp_set_value(L, i, I->values[i]);
+
+            lp_set_gain(L, I->values[LP_MAX_VALUE]);
+        }
+        else J->failed = 1;
+
+        I->p = 0;
+    }
+
+    if (!J->failed)
+    {
+        if (J->f & (LP_RENDER_SH9 | LP_RENDER_SH16 | LP_RENDER_KTX
+                                                   | LP_RENDER_CDF))
+            J->failed = !write_job(L, J);
+        else
+            lp_export_data(L, J->f, J->s, gather, J);
+    }
+
+    if (J->T && !J->failed)
+    {
+        H->T = J->T;
+        H->n = J->n;
+        memcpy(H->d, d, sizeof (d));
+    }
+    else release(L, H);
+}
+
+static void *renderer(void *p)
+{
+    lp_batch   *B = (lp_batch *) p;
+    lightprobe *L = 0;
+    gl_context *C = 0;
+    batch_job  *J;
+    batch_held  H;
+
+    memset(&H, 0, sizeof (H));
+
+    // Open a context and a lightprobe. GLEW initialization is global, so
+    // lightprobes are made and freed one at a time.
+
+    pthread_mutex_lock(&B->mutex);
+    {
+        if ((C = gl_open_context()))
+        {
+            gl_bind_context(C, 1);
+
+            if ((L = lp_init()) == 0)
+            {
+                gl_bind_context(C, 0);
+                gl_free_context(C);
+                C = 0;
+            }
+        }
+        B->ready++;
+        B->ok += (L != 0);
+        pthread_cond_broadcast(&B->cond);
+    }
+
+    while (L && (J = wait_job(B, &B->render)))
+    {
+        size_t z = J->z;
+        double t;
+
+        pthread_mutex_unlock(&B->mutex);
+        {
+            t = now();
+            render_job(L, &H, J);
+            t = now() - t;
+        }
+        pthread_mutex_lock(&B->mutex);
+
+        // The decoded images are gone, and the read-back pages remain.
+
+        B->stats.render += t;
+        B->used         -= z;
+        B->used         += J->z - z;
+        J->z            -= z;
+
+        if (J->failed || J->pages == 0)
+        {
+            pthread_mutex_unlock(&B->mutex);
+            finish(B, J);
+            pthread_mutex_lock(&B->mutex);
+        }
+        else push(&B->encode, J);
+
+        pthread_cond_broadcast(&B->cond);
+    }
+
+    if (L)
+    {
+        lp_free(L);
+        gl_bind_context(C, 0);
+        gl_free_context(C);
+    }
+    pthread_mutex_unlock(&B->mutex);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+static void *encoder(void *p)
+{
+    lp_batch  *B = (lp_batch *) p;
+    batch_job *J;
+
+    pthread_mutex_lock(&B->mutex);
+
+    while ((J = wait_job(B, &B->encode)))
+    {
+        batch_page *P;
+        lp_tiff    *S;
+        char       *q;
+        double      t;
+
+        pthread_mutex_unlock(&B->mutex);
+        {
+            t = now();
+
+            if ((q = suffix(J->path, ".part")) && (S = lp_tiff_open(q)))
+            {
+                for (P = J->pages; P; P = P->next)
+                {
+                    P->tile.p = P->p;
+                    lp_tiff_write(&P->tile, S);
+                }
+                if ((J->failed = !lp_tiff_close(S) || rename(q, J->path)))
+                    remove(q);
+            }
+            else J->failed = 1;
+
+            free(q);
+            t = now() - t;
+        }
+        pthread_mutex_lock(&B->mutex);
+
+        B->stats.encode += t;
+
+        pthread_mutex_unlock(&B->mutex);
+        finish(B, J);
+        pthread_mutex_lock(&B->mutex);
+    }
+
+    pthread_mutex_unlock(&B->mutex);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+static void stop(lp_batch *B)
+{
+    int i;
+
+    pthread_mutex_lock(&B->mutex);
+    {
+        B->quit = 1;
+        pthread_cond_broadcast(&B->cond);
+    }
+    pthread_mutex_unlock(&B->mutex);
+
+    for (i = 0; i < B->threadn; i++)
+        pthread_join(B->threads[i], 0);
+}
+
+// Start a batch with N threads per stage and a budget of M megabytes, with
+// zero being unlimited. Return null if no renderer could open a context.
+
+lp_batch *lp_batch_init(int n, int m)
+{
+    void *(*stage[3])(void *) = { decoder, renderer, encoder };
+
+    lp_batch *B;
+    int       i;
+    int       k;
+
+    if (n < 1)         n = 1;
+    if (n > BATCH_MAX) n = BATCH_MAX;
+
+    if ((B = (lp_batch *) calloc(1, sizeof (lp_batch))))
+    {
+        pthread_mutex_init(&B->mutex, 0);
+        pthread_cond_init (&B->cond,  0);
+
+        B->n      = n;
+        B->budget = (size_t) m << 20;
+        B->start  = now();
+
+        for     (k = 0; k < 3; k++)
+            for (i = 0; i < n; i++)
+                if (pthread_create(B->threads + B->threadn, 0,
+                                   stage[k], B) == 0)
+                    B->threadn++;
+                else if (k == 1)
+                {
+                    pthread_mutex_lock(&B->mutex);
+                    B->ready++;
+                    pthread_mutex_unlock(&B->mutex);
+                }
+
+        // Wait for the renderers to report.
+
+        pthread_mutex_lock(&B->mutex);
+        {
+            while (B->ready < n)
+                pthread_cond_wait(&B->cond, &B->mutex);
+        }
+        pthread_mutex_unlock(&B->mutex);
+
+        if (B->ok)
+            return B;
+
+        stop(B);
+        pthread_cond_destroy (&B->cond);
+        pthread_mutex_destroy(&B->mutex);
+        free(B);
+    }
+    return 0;
+}
+
+static void queue(lp_batch *B, batch_job *J)
+{
+    pthread_mutex_lock(&B->mutex);
+    {
+        push(&B->decode, J);
+        B->pending++;
+        pthread_cond_broadcast(&B->cond);
+    }
+    pthread_mutex_unlock(&B->mutex);
+}
+
+// Queue an export of the named project, as lp_export would write it with the
+// given flags and size to the given path. Return true on success.
+
+int lp_batch_add(lp_batch *B, const char *project, int f, int s,
+                                                   const char *path)
+{
+    batch_job *J;
+
+    assert(B);
+    assert(project);
+    assert(path);
+
+    if ((J = (batch_job *) calloc(1, sizeof (batch_job))))
+    {
+        if ((J->project = (char *) malloc(strlen(project) + 1)) &&
+            (J->path    = (char *) malloc(strlen(path)    + 1)))
+        {
+            strcpy(J->project, project);
+            strcpy(J->path,    path);
+
+            J->f = f;
+            J->s = s;
+
+            queue(B, J);
+            return 1;
+        }
+        free(J->project);
+        free(J);
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+static void free_template(batch_template *T)
+{
+    int k;
+
+    for (k = 0; k < T->n; k++)
+        free(T->paths[k]);
+
+    free(T->project);
+    free(T);
+}
+
+static int add_entry(void *data, const char *path, const float *v, int n)
+{
+    batch_template *T = (batch_template *) data;
+    const int       c = pattern_count(path);
+    int             k;
+
+    if (T->n == BATCH_IMAGES || c < 0 || c > 1)
+    {
+        fprintf(stderr, "%s: bad image pattern %s\n", T->project, path);
+        return 0;
+    }
+    if ((T->paths[T->n] = (char *) malloc(strlen(path) + 1)) == 0)
+        return 0;
+
+    strcpy(T->paths[T->n], path);
+
+    for (k = 0; k < n && k < BATCH_VALUES; k++)
+        T->values[T->n][k] = v[k];
+
+    T->n++;
+    return 1;
+}
+
+// Queue an export of each frame from FIRST to LAST of a sequence. The template
+// project gives the values of each image and, in place of each source path, a
+// pattern such as "frame-%05d.tif" numbered by frame. Each export is written
+// to the path given by the pattern PATH, as lp_batch_add would. Frames already
+// written are skipped, to resume an interrupted sequence. Return the number of
+// frames queued, or -1 on failure. Should queueing fail after some frames are
+// queued, those remain, and their number is returned.
+
+int lp_batch_sequence(lp_batch *B, const char *project, int first, int last,
+                                   int f, int s, const char *path)
+{
+    batch_template *T;
+    batch_job      *J;
+    FILE           *F;
+    char           *p;
+    int             n = 0;
+    int             k;
+
+    assert(B);
+    assert(project);
+    assert(path);
+
+    if (pattern_count(path) != 1)
+    {
+        fprintf(stderr, "%s: output pattern needs one frame number\n", path);
+        return -1;
+    }
+
+    // Read the template and keep it for the life of the batch.
+
+    if ((T = (batch_template *) calloc(1, sizeof (batch_template))) == 0)
+        return -1;
+
+    if ((T->project = (char *) malloc(strlen(project) + 1)) == 0)
+    {
+        free(T);
+        return -1;
+    }
+    strcpy(T->project, project);
+
+    if (!read_project(project, add_entry, T) || T->n == 0)
+    {
+        free_template(T);
+        return -1;
+    }
+
+    pthread_mutex_lock(&B->mutex);
+    {
+        T->next      = B->templates;
+        B->templates = T;
+    }
+    pthread_mutex_unlock(&B->mutex);
+
+    // Queue each frame not yet written.
+
+    for (k = first; k <= last; k++)
+    {
+        if ((p = frame_path(path, k)) == 0)
+            break;
+
+        if ((F = fopen(p, "rb")))
+        {
+            fclose(F);
+            free(p);
+        }
+        else if ((J = (batch_job *) calloc(1, sizeof (batch_job))) &&
+                 (J->project = (char *) malloc(strlen(project) + 1)))
+        {
+            strcpy(J->project, project);
+
+            J->path  = p;
+            J->f     = f;
+            J->s     = s;
+            J->T     = T;
+            J->frame = k;
+
+            queue(B, J);
+            n++;
+        }
+        else
+        {
+            free(J);
+            free(p);
+            break;
+        }
+    }
+
+    if (k <= last)
+    {
+        fprintf(stderr, "%s: could not queue frame %d\n", path, k);
+        return n ? n : -1;
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+
+// Wait for all queued exports to finish, and give the totals since the batch
+// began: wall time, the busy time of each stage summed over its threads, and
+// the pixels exported. Steady time runs from the first export done to the
+// last, so that the sustained rate excludes the filling of the pipeline.
+
+void lp_batch_wait(lp_batch *B, lp_batch_stats *S)
+{
+    assert(B);
+
+    pthread_mutex_lock(&B->mutex);
+    {
+        while (B->pending > 0)
+            pthread_cond_wait(&B->cond, &B->mutex);
+
+        if (S)
+        {
+            *S         = B->stats;
+            S->seconds = now() - B->start;
+        }
+    }
+    pthread_mutex_unlock(&B->mutex);
+}
+
+// Stop all threads and release the batch. Queued exports not yet done are
+// dropped.
+
+void lp_batch_free(lp_batch *B)
+{
+    batch_template *T;
+    batch_job      *J;
+
+    assert(B);
+
+    stop(B);
+
+    while ((J = pop(&B->decode))) free_job(J);
+    while ((J = pop(&B->render))) free_job(J);
+    while ((J = pop(&B->encode))) free_job(J);
+
+    while ((T = B->templates))
+    {
+        B->templates = T->next;
+        free_template(T);
+    }
+
+    pthread_cond_destroy (&B->cond);
+    pthread_mutex_destroy(&B->mutex);
+    free(B);
+}
+
+//------------------------------------------------------------------------------
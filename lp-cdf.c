@@ -0,0 +1,242 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lp-cdf.h"
+#include "lp-task.h"
+#include "lp-kernel.h"
+
+//------------------------------------------------------------------------------
+
+// The sampling table of a W-by-H sphere chart is laid out as a piecewise-
+// constant 2D distribution, so that a renderer may map the file and sample it
+// as it stands. It begins with an identifier, the width and height, and the
+// integral of the function over the unit square, padded to 24 bytes. There
+// follow H rows, top-down as in the chart, each of W function values and the
+// W + 1 values of their normalized CDF. Last come the H row integrals, which
+// are the marginal function, and the H + 1 values of its normalized CDF. All
+// values are 32-bit and native to the host, as a map would read them.
+//
+// The function is the luminance of each pixel weighted by the sine of its
+// polar angle. Its PDF over the unit square is the function divided by the
+// integral, and that over the sphere is this divided by 2 pi^2 sin(theta).
+
+static const unsigned char cdf_id[8] = {
+    0x89, 0x4C, 0x50, 0x43, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+struct cdf
+{
+    char  *path;
+    FILE  *F;
+    int    w;
+    int    h;
+    float *m;
+    float *q;
+    int    n;
+    int    bad;
+};
+
+// Compute the normalized CDF C of the N function values F, and return their
+// integral over the unit interval. Sums are double, as a row may be long. A
+// function of zero gives a uniform CDF.
+
+static float integrate(float *c, const float *f, int n)
+{
+    double s = 0.0;
+    double t = 0.0;
+    int    i;
+
+    for (i = 0; i < n; i++)
+        s += f[i];
+
+    c[0] = 0.0f;
+
+    for (i = 0; i < n; i++)
+    {
+        t += f[i];
+        c[i + 1] = (s > 0.0) ? (float) (t / s) : (float) (i + 1) / n;
+    }
+    c[n] = 1.0f;
+
+    return (float) (s / n);
+}
+
+//------------------------------------------------------------------------------
+
+// Each row is independent of the others, giving its function values, its CDF,
+// and its integral, so a tile of rows is split across threads.
+
+struct rows
+{
+    const char *p;
+    size_t      r;
+    float      *q;
+    float      *m;
+    int         w;
+    int         h;
+    int         y;
+};
+
+typedef struct rows rows;
+
+static void build_rows(void *data, int k, int i0, int i1)
+{
+    const rows *R = (const rows *) data;
+
+    int i;
+    int j;
+
+    for (i = i0; i < i1; i++)
+    {
+        const float *s = (const float *) (R->p + (size_t) i * R->r);
+        const double x = 2.0 * (R->y + i + 0.5) / R->h - 1.0;
+        const double t = KERNEL_COS(x * x);
+
+        float *f = R->q + (size_t) i * (2 * R->w + 1);
+        float *c = f + R->w;
+
+        for (j = 0; j < R->w; j++)
+        {
+            const double l = 0.2126 * s[j * 3 + 0]
+                           + 0.7152 * s[j * 3 + 1]
+                           + 0.0722 * s[j * 3 + 2];
+
+            // Pixels uncovered by any image are not numbers.
+
+            f[j] = (l > 0.0 && isfinite(l)) ? (float) (l * t) : 0.0f;
+        }
+        R->m[i] = integrate(c, f, R->w);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Begin the sampling table of a W-by-H chart in the named file. Return null on
+// failure.
+
+cdf *cdf_open(const char *path, int w, int h)
+{
+    static const char zero[24];
+
+    cdf *C;
+
+    if ((C = (cdf *) calloc(1, sizeof (cdf) + strlen(path) + 1)))
+    {
+        C->path = strcpy((char *) (C + 1), path);
+        C->w    = w;
+        C->h    = h;
+
+        if ((C->m = (float *) malloc((size_t) h * sizeof (float))) &&
+            (C->F = fopen(path, "wb")))
+        {
+            if (fwrite(zero, 1, sizeof (zero), C->F) == sizeof (zero))
+                return C;
+
+            fclose(C->F);
+            remove(path);
+        }
+        free(C->m);
+        free(C);
+    }
+    return 0;
+}
+
+// Add N rows of RGB float pixels P, with a stride of R bytes, beginning at
+// row Y of the chart. Rows must arrive in order, top-down.
+
+void cdf_rows(cdf *C, const void *p, int y, int n, int r)
+{
+    const size_t z = (size_t) n * (2 * C->w + 1);
+
+    rows   R;
+    float *q;
+
+    if (C->n < n)
+    {
+        if ((q = (float *) realloc(C->q, z * sizeof (float))))
+        {
+            C->q = q;
+            C->n = n;
+        }
+        else
+        {
+            C->bad = 1;
+            return;
+        }
+    }
+
+    R.p = (const char *) p;
+    R.r = (size_t) r;
+    R.q = C->q;
+    R.m = C->m + y;
+    R.w = C->w;
+    R.h = C->h;
+    R.y = y;
+
+    task_split(n, build_rows, &R);
+
+    fwrite(C->q, sizeof (float), z, C->F);
+}
+
+// Finish the sampling table with the marginal distribution and the header,
+// and close it. The file is removed if the export was stopped or if writing
+// failed. Return true on success.
+
+int cdf_close(cdf *C, int stopped)
+{
+    const int h = C->h;
+
+    unsigned int d[2];
+    float        s[2];
+    float       *c;
+    int          r = 0;
+
+    if (!stopped && !C->bad &&
+        (c = (float *) malloc((size_t) (h + 1) * sizeof (float))))
+    {
+        d[0] = (unsigned int) C->w;
+        d[1] = (unsigned int) C->h;
+        s[0] = integrate(c, C->m, h);
+        s[1] = 0.0f;
+
+        r = fwrite(C->m, sizeof (float), h,     C->F) == (size_t)  h
+         && fwrite(c,    sizeof (float), h + 1, C->F) == (size_t) (h + 1)
+         && fseek (C->F, 0, SEEK_SET) == 0
+         && fwrite(cdf_id, 1,              8, C->F) == 8
+         && fwrite(d,      sizeof (d[0]),  2, C->F) == 2
+         && fwrite(s,      sizeof (s[0]),  2, C->F) == 2;
+
+        free(c);
+    }
+
+    if (ferror(C->F))
+        r = 0;
+
+    if (fclose(C->F) || !r)
+    {
+        remove(C->path);
+        r = 0;
+    }
+
+    free(C->q);
+    free(C->m);
+    free(C);
+
+    return r;
+}
+
+//------------------------------------------------------------------------------
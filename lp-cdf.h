@@ -0,0 +1,26 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef LP_CDF_H
+#define LP_CDF_H
+
+//------------------------------------------------------------------------------
+
+typedef struct cdf cdf;
+
+cdf *cdf_open (const char *, int, int);
+void cdf_rows (cdf *, const void *, int, int, int);
+int  cdf_close(cdf *, int);
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -1,12 +1,47 @@
 #extension GL_ARB_texture_rectangle : enable
 
 uniform sampler2DRect image;
+uniform sampler2DRect atlas;
+uniform sampler2DRect table;
+uniform vec4          image_r;
+uniform vec2          image_k;
+uniform int           page_n;
+uniform float         page_s;
+uniform float         page_g;
+uniform vec2          page_k[16];
 uniform vec2          circle_p;
 uniform float         circle_r;
 uniform float         expo_n;
 
 /*----------------------------------------------------------------------------*/
 
+// Sample image pixel q at level of detail d. A paged image gives the finest
+// resident page at or above that level, and any image falls back to its
+// texture, which is a preview if the image is paged. Both cover only the
+// loaded region of the image, and nothing is given beyond it.
+
+vec4 texel(vec2 q, float d)
+{
+    q = q - image_r.xy;
+
+    if (any(lessThan(q, vec2(0.0))) || any(greaterThanEqual(q, image_r.zw)))
+        return vec4(0.0);
+
+    for (int l = 0; l < 16; l++)
+        if (l < page_n && float(l) >= d)
+        {
+            vec2 t = q * page_k[l];
+            vec2 g = floor(t / page_s);
+            vec4 e = texture2DRect(table, vec2(g.x, g.y + float(l) * page_g)
+                                        + 0.5);
+            if (e.a > 0.0)
+                return texture2DRect(atlas, e.xy * (page_s + 2.0) + 1.0
+                                                 + t - g * page_s);
+        }
+
+    return texture2DRect(image, q * image_k);
+}
+
 float impulse(float r, float dr, float x)
 {
     return smoothstep(r - dr, r, x) * (1.0 - smoothstep(r, r + dr, x));
@@ -18,7 +53,7 @@ void main()
     float d = fwidth(p).x;
     float r = length(p - circle_p);
 
-    vec4  c = texture2DRect(image, p);
+    vec4  c = texel(p, floor(log2(max(d, 1.0))));
     vec3  C = 1.0 - exp(-expo_n * c.rgb);
 
     float k = impulse(circle_r * 1.00, d * 2.0, r)
@@ -0,0 +1,223 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lp-gain.h"
+#include "lp-kernel.h"
+
+//------------------------------------------------------------------------------
+
+// Gains are found in stops. Every pixel seen by two images gives a sample of
+// the difference of their log luminance, and the gains that best cancel these
+// differences solve a small linear system. Misaligned or clipped pixels are
+// outliers, so the fit is robust: iteratively reweighted least squares with
+// the Huber weight, which trusts residuals up to GAIN_HUBER stops fully and
+// larger ones less. The mean gain is held at zero, as only differences are
+// known.
+
+#define GAIN_MAX   16
+#define GAIN_ITER  8
+#define GAIN_HUBER 0.25
+
+struct sample
+{
+    int   a;
+    int   b;
+    float d;
+    float w;
+};
+
+typedef struct sample sample;
+
+// Find the log2 luminance L of the premultiplied sample C. Return false if
+// there is too little of it to measure.
+
+static int loglum(const float *c, double *l)
+{
+    const double y = 0.2126 * c[0] + 0.7152 * c[1] + 0.0722 * c[2];
+
+    if (c[3] > 1.0e-3f && y > 0.0 && isfinite(y))
+    {
+        *l = log2(y / c[3]);
+        return 1;
+    }
+    return 0;
+}
+
+// Solve the N-by-N system A x = b in place by Gaussian elimination with partial
+// pivoting, leaving the solution in b.
+
+static void solve(double A[][GAIN_MAX], double *b, int n)
+{
+    double t;
+    int    i;
+    int    j;
+    int    k;
+    int    p;
+
+    for (k = 0; k < n; k++)
+    {
+        for (p = k, i = k + 1; i < n; i++)
+            if (fabs(A[i][k]) > fabs(A[p][k]))
+                p = i;
+
+        if (p != k)
+        {
+            for (j = 0; j < n; j++)
+            {
+                t = A[k][j]; A[k][j] = A[p][j]; A[p][j] = t;
+            }
+            t = b[k]; b[k] = b[p]; b[p] = t;
+        }
+
+        if (A[k][k] == 0.0)
+            continue;
+
+        for (i = k + 1; i < n; i++)
+        {
+            const double m = A[i][k] / A[k][k];
+
+            for (j = k; j < n; j++)
+                A[i][j] -= m * A[k][j];
+
+            b[i] -= m * b[k];
+        }
+    }
+
+    for (k = n - 1; k >= 0; k--)
+    {
+        for (j = k + 1; j < n; j++)
+            b[k] -= A[k][j] * b[j];
+
+        b[k] = (A[k][k] != 0.0) ? b[k] / A[k][k] : 0.0;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Find the exposures of N images that best match them where they overlap. P
+// gives each image blended alone to a W-by-H sphere chart, as premultiplied
+// color with weight in alpha, rows bottom-up. E gives the exposures at which
+// they were blended, in stops, and G receives the solution. Return the number
+// of samples of overlap, leaving G as E if there are none.
+
+int gain_solve(const float **p, int n, int w, int h, const float *e, float *g)
+{
+    double  A[GAIN_MAX][GAIN_MAX];
+    double  b[GAIN_MAX];
+    double  l[GAIN_MAX];
+    int     v[GAIN_MAX];
+    sample *S;
+    int     m = 0;
+    int     i;
+    int     j;
+    int     k;
+    int     x;
+    int     y;
+
+    memcpy(g, e, n * sizeof (float));
+
+    if (n < 2 || n > GAIN_MAX)
+        return 0;
+
+    if ((S = (sample *) malloc((size_t) w * h * n * (n - 1) / 2
+                                                  * sizeof (sample))) == 0)
+        return 0;
+
+    // Gather the differences of log luminance at unit gain, weighted by the
+    // solid angle of each pixel.
+
+    for (y = 0; y < h; y++)
+    {
+        const float t = 2.0f * (y + 0.5f) / h - 1.0f;
+        const float c = KERNEL_COS(t * t);
+
+        for (x = 0; x < w; x++)
+        {
+            const size_t o = ((size_t) y * w + x) * 4;
+
+            for (i = 0; i < n; i++)
+                if ((v[i] = loglum(p[i] + o, l + i)))
+                    l[i] -= e[i];
+
+            for     (i = 0;     i < n; i++)
+                for (j = i + 1; j < n; j++)
+                    if (v[i] && v[j])
+                    {
+                        S[m].a = i;
+                        S[m].b = j;
+                        S[m].d = (float) (l[i] - l[j]);
+                        S[m].w = c;
+                        m++;
+                    }
+        }
+    }
+
+    // Reweight and solve.
+
+    if (m)
+    {
+        double q[GAIN_MAX];
+
+        memset(q, 0, sizeof (q));
+
+        for (k = 0; k < GAIN_ITER; k++)
+        {
+            double t = 0.0;
+
+            memset(A, 0, sizeof (A));
+            memset(b, 0, sizeof (b));
+
+            for (j = 0; j < m; j++)
+            {
+                const double r = fabs(S[j].d + q[S[j].a] - q[S[j].b]);
+                const double u = S[j].w * ((r > GAIN_HUBER) ? GAIN_HUBER / r
+                                                            : 1.0);
+                A[S[j].a][S[j].a] += u;
+                A[S[j].b][S[j].b] += u;
+                A[S[j].a][S[j].b] -= u;
+                A[S[j].b][S[j].a] -= u;
+
+                b[S[j].a] -= u * S[j].d;
+                b[S[j].b] += u * S[j].d;
+
+                t += u;
+            }
+
+            // Hold the mean at zero, and pull any image that overlaps none
+            // toward it.
+
+            for (i = 0; i < n; i++)
+            {
+                for (j = 0; j < n; j++)
+                    A[i][j] += t / n;
+
+                A[i][i] += 1.0e-6 * t;
+            }
+
+            solve(A, b, n);
+
+            memcpy(q, b, sizeof (q));
+        }
+
+        for (i = 0; i < n; i++)
+            g[i] = (float) q[i];
+    }
+
+    free(S);
+    return m;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,22 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef LP_GAIN_H
+#define LP_GAIN_H
+
+//------------------------------------------------------------------------------
+
+int gain_solve(const float **, int, int, int, const float *, float *);
+
+//------------------------------------------------------------------------------
+
+#endif
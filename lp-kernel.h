@@ -0,0 +1,153 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef LP_KERNEL_H
+#define LP_KERNEL_H
+
+//------------------------------------------------------------------------------
+
+// The projection kernels of the sphere passes. This file is both a C header and
+// a GLSL library. Only the polynomials below are shared with C, where they give
+// the chart directions of the CPU passes. The mappings that use them are seen
+// by the GLSL compiler alone, which does not define __STDC__. The library is
+// compiled once as a fragment shader and linked with every sphere pass, which
+// declares the mappings it calls.
+//
+// Sine and cosine of pi/2 x for x in [-1, 1] are given by minimax polynomials
+// in x and XX = x^2, of degree 9 and 8. With the coefficients as written, their
+// greatest errors are 3.5e-9 and 5.1e-8, at or below the precision of a float
+// near one. C and GLSL round the coefficients to float, giving 4.9e-8 and
+// 8.4e-8. check-kernel measures both, and the GLSL mappings on a GL context.
+
+#if !defined(__STDC__) && !defined(_MSC_VER)
+#define KERNEL_GLSL
+#endif
+
+#ifdef KERNEL_GLSL
+#define KERNEL_F(x) x
+#else
+#define KERNEL_F(x) ((float) (x))
+#endif
+
+#define KS1 KERNEL_F( 1.57079629e+0)
+#define KS3 KERNEL_F(-6.45963360e-1)
+#define KS5 KERNEL_F( 7.96884806e-2)
+#define KS7 KERNEL_F(-4.67222804e-3)
+#define KS9 KERNEL_F( 1.50820615e-4)
+
+#define KC0 KERNEL_F( 9.99999954e-1)
+#define KC2 KERNEL_F(-1.23369822e+0)
+#define KC4 KERNEL_F( 2.53650746e-1)
+#define KC6 KERNEL_F(-2.08106298e-2)
+#define KC8 KERNEL_F( 8.58191647e-4)
+
+// GLSL 1.10 has no line continuation, so these stay on one line each.
+
+#define KERNEL_H(t, a, b, c, d, e) ((a)+(t)*((b)+(t)*((c)+(t)*((d)+(t)*(e)))))
+
+#define KERNEL_SIN(x, xx) ((x) * KERNEL_H(xx, KS1, KS3, KS5, KS7, KS9))
+#define KERNEL_COS(xx)           KERNEL_H(xx, KC0, KC2, KC4, KC6, KC8)
+
+//------------------------------------------------------------------------------
+#ifdef KERNEL_GLSL
+
+// Map unit direction n to the unit disc of an angular map, to be scaled and
+// offset by the circle of each image as it is sampled. The radius sin(acos(z)
+// / 2) over the length of n.xy reduces to 1 / sqrt(2 + 2z), leaving the pole at
+// the center well-defined. It grows without bound toward the opposite pole,
+// which no image sees.
+
+vec2 unwrap(vec3 n)
+{
+    return n.xy * inversesqrt(2.0 + 2.0 * n.z);
+}
+
+// Give the sampling weight of unit disc coordinate u, the reciprocal of its
+// density, scaled to match a 3x3 Sobel estimate of the same.
+
+float weight(vec2 u)
+{
+    return 1.0 / (8.0 * length(vec2(length(dFdx(u)), length(dFdy(u)))));
+}
+
+// Give the level of detail of an image of radius R at unit disc weight W, the
+// log2 of the image pixels spanned by a pixel of the view. The Sobel scale of
+// the weight, 8, and the length taken over both axes, sqrt(2), give the 11.3.
+
+float footprint(float r, float w)
+{
+    return floor(log2(max(r / (11.3 * w), 1.0)));
+}
+
+// Map chart coordinate v in [0, 1] to a direction, longitude pi - 2 pi v.x and
+// latitude pi/2 - pi v.y. Longitude is twice the angle of the polynomials, so
+// its sine and cosine are found by the double-angle identities.
+
+vec3 chart(vec2 v)
+{
+    vec2 x  = 1.0 - 2.0 * v;
+    vec2 xx = x * x;
+    vec2 s  = KERNEL_SIN(x, xx);
+    vec2 c  = KERNEL_COS(xx);
+
+    return vec3(2.0 * s.x * c.x * c.y, -s.y, (c.x * c.x - s.x * s.x) * c.y);
+}
+
+// Map polar coordinate v, in the unit disc, to a direction, longitude the angle
+// of v and latitude pi/2 (1 - |v|). The sine and cosine of longitude are the
+// components of v over its length, guarded at the center, where the cosine of
+// latitude goes to zero with the length.
+
+vec3 polar(vec2 v)
+{
+    float r  = length(v);
+    float x  = 1.0 - r;
+    float xx = x * x;
+    float s  = KERNEL_SIN(x, xx);
+    float c  = KERNEL_COS(xx);
+
+    vec2  k  = v * (c / max(r, 1.0e-6));
+
+    return vec3(k.x, -s, k.y);
+}
+
+// Map octahedral coordinate s, in [-1, 1], to a direction. The inner diamond is
+// the upper hemisphere, with the zenith at the center as in the polar map, and
+// the corners fold over to the lower hemisphere.
+
+vec3 octa(vec2 s)
+{
+    float h = 1.0 - abs(s.x) - abs(s.y);
+
+    if (h < 0.0)
+        s = (1.0 - abs(s.yx)) * (2.0 * step(0.0, s) - 1.0);
+
+    return normalize(vec3(s.x, -h, s.y));
+}
+
+// Map coordinate c in [-1, 1] of the given cube face to a direction in the GL
+// cube map layout.
+
+vec3 direction(int face, vec2 c)
+{
+    if      (face == 0) return vec3( 1.0, -c.y, -c.x);
+    else if (face == 1) return vec3(-1.0, -c.y,  c.x);
+    else if (face == 2) return vec3( c.x,  1.0,  c.y);
+    else if (face == 3) return vec3( c.x, -1.0, -c.y);
+    else if (face == 4) return vec3( c.x, -c.y,  1.0);
+    else                return vec3(-c.x, -c.y, -1.0);
+}
+
+#endif
+//------------------------------------------------------------------------------
+
+#endif
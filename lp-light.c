@@ -0,0 +1,302 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lp-render.h"
+#include "lp-light.h"
+#include "lp-task.h"
+#include "lp-kernel.h"
+
+//------------------------------------------------------------------------------
+
+// Median cut divides the chart into regions of equal energy, each time cutting
+// every region across its longer side, as measured on the sphere. The energy
+// of any rectangle comes from a summed-area table of luminance weighted by
+// solid angle, so each cut is a binary search. The table is built in two
+// threaded passes, a prefix sum along each row and then down each column. The
+// pixels of each final region are visited once, to find its light.
+
+struct cut
+{
+    const float  *p;
+    int           w;
+    int           h;
+    double       *S;
+    const double *sx;
+    const double *cx;
+    const int    *r;
+    lp_light     *L;
+};
+
+typedef struct cut cut;
+
+// Return the cosine of the latitude of row I, the solid angle weight of its
+// pixels, with rows bottom-up as read back.
+
+static double lat(int i, int h)
+{
+    const double x = 2.0 * (i + 0.5) / h - 1.0;
+
+    return KERNEL_COS(x * x);
+}
+
+static double lum(const float *q)
+{
+    const double l = 0.2126 * q[0] + 0.7152 * q[1] + 0.0722 * q[2];
+
+    // Pixels uncovered by any image are not numbers.
+
+    return (l > 0.0 && isfinite(l)) ? l : 0.0;
+}
+
+// Return the energy of the region [x0, x1) by [y0, y1).
+
+static double sum(const cut *C, int x0, int y0, int x1, int y1)
+{
+    const size_t m = (size_t) C->w + 1;
+
+    return C->S[y1 * m + x1] - C->S[y0 * m + x1]
+         - C->S[y1 * m + x0] + C->S[y0 * m + x0];
+}
+
+//------------------------------------------------------------------------------
+
+static void row_sums(void *data, int k, int i0, int i1)
+{
+    const cut   *C = (const cut *) data;
+    const size_t m = (size_t) C->w + 1;
+
+    int i;
+    int j;
+
+    for (i = i0; i < i1; i++)
+    {
+        const float *q = C->p + (size_t) i * C->w * 3;
+        const double t = lat(i, C->h);
+
+        double *s = C->S + (i + 1) * m;
+        double  a = 0.0;
+
+        s[0] = 0.0;
+
+        for (j = 0; j < C->w; j++)
+            s[j + 1] = (a += lum(q + j * 3) * t);
+    }
+}
+
+static void col_sums(void *data, int k, int j0, int j1)
+{
+    const cut   *C = (const cut *) data;
+    const size_t m = (size_t) C->w + 1;
+
+    int i;
+    int j;
+
+    for     (i = 1; i <= C->h; i++)
+        for (j = j0; j < j1; j++)
+            C->S[i * m + j + 1] += C->S[(i - 1) * m + j + 1];
+}
+
+// Find the light of each region: its color is the sum of radiance times solid
+// angle, and its direction the energy-weighted mean of its pixels.
+
+static void find_lights(void *data, int k, int n0, int n1)
+{
+    const cut   *C  = (const cut *) data;
+    const double dw = 2.0 * M_PI / C->w;
+    const double dh =       M_PI / C->h;
+
+    int n;
+    int i;
+    int j;
+
+    for (n = n0; n < n1; n++)
+    {
+        const int *r = C->r + n * 4;
+
+        double c[3] = { 0.0, 0.0, 0.0 };
+        double d[3] = { 0.0, 0.0, 0.0 };
+        double e[3] = { 0.0, 0.0, 0.0 };
+        double a    = 0.0;
+        double l;
+
+        for (i = r[1]; i < r[3]; i++)
+        {
+            const double u  = 2.0 * (i + 0.5) / C->h - 1.0;
+            const double uu = u * u;
+            const double ct = KERNEL_COS(uu);
+            const double st = KERNEL_SIN(u, uu);
+            const double da = ct * dw * dh;
+
+            const float *q = C->p + ((size_t) i * C->w + r[0]) * 3;
+
+            for (j = r[0]; j < r[2]; j++, q += 3)
+            {
+                const double x =  C->sx[j] * ct;
+                const double y = -st;
+                const double z =  C->cx[j] * ct;
+                const double g = lum(q) * da;
+
+                if (g > 0.0)
+                {
+                    c[0] += q[0] * da;
+                    c[1] += q[1] * da;
+                    c[2] += q[2] * da;
+                }
+
+                d[0] += g * x;
+                d[1] += g * y;
+                d[2] += g * z;
+
+                e[0] += da * x;
+                e[1] += da * y;
+                e[2] += da * z;
+
+                a += da;
+            }
+        }
+
+        // A dark region points to its middle.
+
+        if ((l = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2])) == 0.0)
+        {
+            memcpy(d, e, sizeof (d));
+            l = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        }
+
+        for (i = 0; i < 3; i++)
+        {
+            C->L[n].d[i] = (float) (l > 0.0 ? d[i] / l : 0.0);
+            C->L[n].c[i] = (float) c[i];
+        }
+        C->L[n].a = (float) a;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Cut region R in two at the median of its energy, across its longer side,
+// giving the second half in Q. Return false if R is a single pixel.
+
+static int split(const cut *C, int *r, int *q)
+{
+    const double t  = lat((r[1] + r[3]) / 2, C->h);
+    const double dx = (double) (r[2] - r[0]) * t / C->w * 2.0;
+    const double dy = (double) (r[3] - r[1])     / C->h;
+
+    const int k = ((dx >= dy && r[2] - r[0] > 1) || r[3] - r[1] < 2) ? 0 : 1;
+
+    double h;
+    int    a;
+    int    b;
+    int    m;
+
+    if (r[2] - r[0] < 2 && r[3] - r[1] < 2)
+        return 0;
+
+    // Search for the first cut at which the near side holds half.
+
+    h = sum(C, r[0], r[1], r[2], r[3]) / 2.0;
+    a = r[k] + 1;
+    b = r[k + 2] - 1;
+
+    while (a < b)
+    {
+        m = (a + b) / 2;
+
+        if ((k ? sum(C, r[0], r[1], r[2], m)
+               : sum(C, r[0], r[1], m, r[3])) < h)
+            a = m + 1;
+        else
+            b = m;
+    }
+
+    memcpy(q, r, 4 * sizeof (int));
+
+    r[k + 2] = a;
+    q[k]     = a;
+
+    return 1;
+}
+
+// Find up to 2^K lights in the W-by-H RGB chart P, as read back from an
+// equirectangular render, with rows bottom-up. Directions follow the chart
+// projection, as do those of the spherical harmonics. Return the number of
+// lights written to L, fewer than 2^K only if the chart has too few pixels.
+
+int light_cut(const float *p, int w, int h, int k, lp_light *L)
+{
+    const int m = 1 << k;
+
+    int    *r  = (int    *) malloc((size_t) m * 4 * sizeof (int));
+    double *sx = (double *) malloc((size_t) w * sizeof (double));
+    double *cx = (double *) malloc((size_t) w * sizeof (double));
+    double *S  = (double *) calloc((size_t) (w + 1) * (h + 1),
+                                                      sizeof (double));
+    int n = 0;
+    int i;
+    int j;
+
+    if (r && sx && cx && S)
+    {
+        cut C;
+
+        for (j = 0; j < w; j++)
+        {
+            const double x  = 1.0 - 2.0 * (j + 0.5) / w;
+            const double xx = x * x;
+            const double hs = KERNEL_SIN(x, xx);
+            const double hc = KERNEL_COS(xx);
+
+            sx[j] = 2.0 * hs * hc;
+            cx[j] = hc * hc - hs * hs;
+        }
+
+        C.p  = p;
+        C.w  = w;
+        C.h  = h;
+        C.S  = S;
+        C.sx = sx;
+        C.cx = cx;
+        C.r  = r;
+        C.L  = L;
+
+        task_split(h, row_sums, &C);
+        task_split(w, col_sums, &C);
+
+        // Cut every region at each step.
+
+        r[0] = 0;
+        r[1] = 0;
+        r[2] = w;
+        r[3] = h;
+
+        for (n = 1, i = 0; i < k; i++)
+            for (j = n; j > 0; j--)
+                if (split(&C, r + (j - 1) * 4, r + n * 4))
+                    n++;
+
+        task_split(n, find_lights, &C);
+    }
+
+    free(S);
+    free(cx);
+    free(sx);
+    free(r);
+
+    return n;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,205 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lp-merge.h"
+#include "lp-task.h"
+
+//------------------------------------------------------------------------------
+
+#define MERGE_MAX 16
+
+// Decode an sRGB value in [0, 1] to linear.
+
+static double srgb(double v)
+{
+    return (v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+// Evaluate the inverse camera response at V in [0, 1]. G gives M samples of
+// the response uniformly over [0, 1], interpolated linearly. With no curve,
+// 8-bit values are taken to be sRGB encoded and 16-bit values linear.
+
+static double response(double v, int b, const float *g, int m)
+{
+    if (g && m > 1)
+    {
+        double x = v * (m - 1);
+        int    i = (int) floor(x);
+
+        if (i <  0)     return g[0];
+        if (i >= m - 1) return g[m - 1];
+
+        return g[i] + (x - i) * (g[i + 1] - g[i]);
+    }
+    return (b == 8) ? srgb(v) : v;
+}
+
+//------------------------------------------------------------------------------
+
+// Merging is driven entirely by tables indexed by sample value: one of hat-
+// shaped weights, favoring mid-range values, and one per exposure of relative
+// radiance, the linearized value divided by the exposure time. The inner loop
+// is thus a pair of table lookups and a multiply-add per exposure, and the
+// rows are split across threads.
+
+struct merge
+{
+    const void  **p;
+    int           n;
+    int           w;
+    int           c;
+    int           b;
+    const float  *W;
+    const float **E;
+    int           lo;
+    int           hi;
+    float        *q;
+};
+
+typedef struct merge merge;
+
+static int sample(const merge *M, int k, size_t i)
+{
+    return (M->b == 8) ? ((const unsigned char  *) M->p[k])[i]
+                       : ((const unsigned short *) M->p[k])[i];
+}
+
+static void merge_rows(void *data, int t, int i0, int i1)
+{
+    const merge *M = (const merge *) data;
+
+    const int    a = (M->c == 2 || M->c == 4) ? M->c - 1 : -1;
+    const size_t m = (size_t) M->w * M->c;
+    const int    z = (1 << M->b) - 1;
+
+    size_t i;
+    int    k;
+
+    for (i = (size_t) i0 * m; i < (size_t) i1 * m; i++)
+    {
+        // Alpha is not an exposure, so take it from the first image.
+
+        if ((int) (i % M->c) == a)
+            M->q[i] = (float) sample(M, 0, i) / z;
+        else
+        {
+            float num = 0.0f;
+            float den = 0.0f;
+
+            for (k = 0; k < M->n; k++)
+            {
+                const int v = sample(M, k, i);
+
+                num += M->W[v] * M->E[k][v];
+                den += M->W[v];
+            }
+
+            // A value clipped in every exposure is best told by the shortest
+            // exposure if bright and by the longest if dark.
+
+            if (den > 0.0f)
+                M->q[i] = num / den;
+            else
+            {
+                const int v = sample(M, M->lo, i);
+
+                if (v > z / 2)
+                    M->q[i] = M->E[M->lo][v];
+                else
+                    M->q[i] = M->E[M->hi][sample(M, M->hi, i)];
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Merge N bracketed exposures to one floating point radiance image. P gives
+// the W-by-H images with C channels of B bits each, 8 or 16, and T gives the
+// exposure times, or any values proportional to them. G gives the inverse
+// camera response curve as M samples, or null to assume one. Return a new
+// buffer of the merged image, or null on failure.
+
+float *merge_bracket(const void **p, const float *t, int n,
+                     int w, int h, int c, int b, const float *g, int m)
+{
+    const int z = (1 << b) - 1;
+
+    float *E[MERGE_MAX];
+    float *W = 0;
+    float *q = 0;
+    merge  M;
+    int    k;
+    int    v;
+
+    if (n < 1 || n > MERGE_MAX || (b != 8 && b != 16))
+        return 0;
+
+    for (k = 0; k < n; k++)
+        if (t[k] <= 0.0f)
+            return 0;
+
+    memset(E, 0, sizeof (E));
+
+    // Build the weight and radiance tables.
+
+    if ((W = (float *) malloc((z + 1) * sizeof (float))))
+        for (v = 0; v <= z; v++)
+            W[v] = (float) (1.0 - fabs(2.0 * v / z - 1.0));
+
+    for (k = 0; k < n; k++)
+        if ((E[k] = (float *) malloc((z + 1) * sizeof (float))))
+            for (v = 0; v <= z; v++)
+                E[k][v] = (float) (response((double) v / z, b, g, m) / t[k]);
+
+    // Merge all rows.
+
+    M.p  = p;
+    M.n  = n;
+    M.w  = w;
+    M.c  = c;
+    M.b  = b;
+    M.W  = W;
+    M.E  = (const float **) E;
+    M.lo = 0;
+    M.hi = 0;
+
+    for (k = 1; k < n; k++)
+    {
+        if (t[k] < t[M.lo]) M.lo = k;
+        if (t[k] > t[M.hi]) M.hi = k;
+    }
+
+    for (k = 0; k < n; k++)
+        if (E[k] == 0)
+            break;
+
+    if (W && k == n && (q = (float *) malloc((size_t) w * h * c
+                                                     * sizeof (float))))
+    {
+        M.q = q;
+        task_split(h, merge_rows, &M);
+    }
+
+    for (k = 0; k < n; k++)
+        free(E[k]);
+
+    free(W);
+
+    return q;
+}
+
+//------------------------------------------------------------------------------
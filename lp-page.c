@@ -0,0 +1,100 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <stdlib.h>
+#include <string.h>
+#include <tiffio.h>
+
+#include "lp-page.h"
+#include "lp-project.h"
+
+//------------------------------------------------------------------------------
+
+// Make the pyramid of a W-by-H buffer with rows R bytes apart, or packed if R
+// is zero, and C channels of B bits in TIFF sample format F. Level zero is a
+// conversion of the buffer, and each level after is a box filtering of the one
+// before, so that level coordinates are exactly proportional to image
+// coordinates at every level.
+
+page_source *page_init(const void *p, size_t r, int w, int h,
+                                     int c, int b, int f)
+{
+    page_source *P;
+    int          l;
+
+    if ((P = (page_source *) calloc(1, sizeof (page_source))))
+    {
+        P->refs = 1;
+        P->p[0] = project_preview(p, r, w, h, c, b, f, (w > h) ? w : h,
+                                  P->w, P->h);
+
+        for (l = 0; P->p[l] && l < PAGE_LEVELS - 1; l++)
+        {
+            const int s = (P->w[l] > P->h[l]) ? P->w[l] : P->h[l];
+
+            if (s <= PAGE_SIZE)
+                break;
+
+            P->p[l + 1] = project_preview(P->p[l], 0, P->w[l], P->h[l], 4, 16,
+                                          SAMPLEFORMAT_IEEEFP, (s + 1) / 2,
+                                          P->w + l + 1, P->h + l + 1);
+        }
+
+        P->n = l + 1;
+
+        if (P->p[l])
+            return P;
+
+        page_free(P);
+    }
+    return 0;
+}
+
+void page_free(page_source *P)
+{
+    int l;
+
+    for (l = 0; l < PAGE_LEVELS; l++)
+        free(P->p[l]);
+
+    free(P);
+}
+
+// Copy page X, Y of level L, with its border, to a PAGE_STRIDE-square buffer.
+// Texels beyond the edge of the level repeat the edge.
+
+void page_copy(const page_source *P, int l, int x, int y, unsigned short *q)
+{
+    const int w = P->w[l];
+    const int h = P->h[l];
+    int i;
+    int j;
+
+    for     (i = 0; i < PAGE_STRIDE; i++)
+    {
+        int r = y * PAGE_SIZE + i - 1;
+
+        r = (r < 0) ? 0 : ((r < h) ? r : h - 1);
+
+        for (j = 0; j < PAGE_STRIDE; j++)
+        {
+            int s = x * PAGE_SIZE + j - 1;
+
+            s = (s < 0) ? 0 : ((s < w) ? s : w - 1);
+
+            memcpy(q + ((size_t) i * PAGE_STRIDE + j) * 4,
+                   P->p[l] + ((size_t) r * w + s) * 4, 4 * sizeof (short));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,48 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef LP_PAGE_H
+#define LP_PAGE_H
+
+//------------------------------------------------------------------------------
+
+// Pages are square, with a border of one texel on each side for filtering.
+
+#define PAGE_SIZE   256
+#define PAGE_STRIDE (PAGE_SIZE + 2)
+#define PAGE_LEVELS 16
+
+// A page source is the host-side pyramid of a virtually textured image, with
+// RGBA 16-bit float texels. Level zero is the image at full resolution, and
+// each level after halves the one before until it fits a single page. It is
+// immutable once made, and shared by reference count.
+
+struct page_source
+{
+    int             refs;
+    int             n;
+    int             w[PAGE_LEVELS];
+    int             h[PAGE_LEVELS];
+    unsigned short *p[PAGE_LEVELS];
+};
+
+typedef struct page_source page_source;
+
+//------------------------------------------------------------------------------
+
+page_source *page_init(const void *, size_t, int, int, int, int, int);
+void         page_free(page_source *);
+void         page_copy(const page_source *, int, int, int, unsigned short *);
+
+//------------------------------------------------------------------------------
+
+#endif
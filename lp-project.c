@@ -0,0 +1,497 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <tiffio.h>
+
+#include "lp-project.h"
+
+//------------------------------------------------------------------------------
+
+// A project file begins with an identifier, a version, and an image count.
+// Each image follows with its path, hash, size, the region of it loaded, a
+// counted list of values, and its preview. All integers are little-endian,
+// regardless of the host. Version 1 lacks the region, which is then the whole.
+
+#define PROJECT_VERSION 2
+
+static const unsigned char project_id[8] = {
+    0x89, 0x4C, 0x50, 0x52, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+//------------------------------------------------------------------------------
+
+static int put32(FILE *F, unsigned int v)
+{
+    unsigned char p[4];
+
+    p[0] = (unsigned char) (v      );
+    p[1] = (unsigned char) (v >>  8);
+    p[2] = (unsigned char) (v >> 16);
+    p[3] = (unsigned char) (v >> 24);
+
+    return fwrite(p, 1, 4, F) == 4;
+}
+
+static int put64(FILE *F, unsigned long long v)
+{
+    return put32(F, (unsigned int) (v      ))
+        && put32(F, (unsigned int) (v >> 32));
+}
+
+static int putf(FILE *F, float f)
+{
+    unsigned int v;
+
+    memcpy(&v, &f, 4);
+    return put32(F, v);
+}
+
+static int get32(FILE *F, unsigned int *v)
+{
+    unsigned char p[4];
+
+    if (fread(p, 1, 4, F) == 4)
+    {
+        *v = ((unsigned int) p[0]      ) | ((unsigned int) p[1] <<  8)
+           | ((unsigned int) p[2] << 16) | ((unsigned int) p[3] << 24);
+        return 1;
+    }
+    return 0;
+}
+
+static int get64(FILE *F, unsigned long long *v)
+{
+    unsigned int a;
+    unsigned int b;
+
+    if (get32(F, &a) && get32(F, &b))
+    {
+        *v = (unsigned long long) a | ((unsigned long long) b << 32);
+        return 1;
+    }
+    return 0;
+}
+
+static int getf(FILE *F, float *f)
+{
+    unsigned int v;
+
+    if (get32(F, &v))
+    {
+        memcpy(f, &v, 4);
+        return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+// Convert a float to half, rounding to nearest. Values beyond the half range
+// clamp to the largest finite half, as an infinity would poison a blend, and
+// NaN becomes zero.
+
+static unsigned short half(float f)
+{
+    unsigned int u;
+    unsigned int s;
+    unsigned int m;
+    int          e;
+
+    memcpy(&u, &f, 4);
+
+    s = (u >> 16) & 0x8000;
+    e = (int) ((u >> 23) & 0xFF) - 127 + 15;
+    m =  u & 0x7FFFFF;
+
+    if ((u & 0x7FFFFFFF) > 0x7F800000) return 0;
+    if (e >= 31)                       return (unsigned short) (s | 0x7BFF);
+    if (e <= 0)
+    {
+        if (e < -10) return (unsigned short) s;
+
+        m |= 0x800000;
+        return (unsigned short) (s | (m >> (14 - e)));
+    }
+
+    u = s | ((unsigned int) e << 10) | (m >> 13);
+
+    if ((m & 0x1000) && (u & 0x7FFF) < 0x7BFF)
+        u++;
+
+    return (unsigned short) u;
+}
+
+static float unhalf(unsigned short h)
+{
+    unsigned int s = (unsigned int) (h & 0x8000) << 16;
+    unsigned int e = (h >> 10) & 0x1F;
+    unsigned int m =  h & 0x3FF;
+    unsigned int u;
+    float        f;
+
+    if      (e == 0)
+    {
+        f = (float) m / 16777216.0f;
+        return s ? -f : f;
+    }
+    else if (e == 31) u = s | 0x7F800000 | (m << 13);
+    else              u = s | ((e - 15 + 127) << 23) | (m << 13);
+
+    memcpy(&f, &u, 4);
+    return f;
+}
+
+// Return sample I of a buffer with B bits per sample in TIFF sample format F,
+// normalizing integers as OpenGL does upon upload.
+
+static float sample(const void *p, int b, int f, size_t i)
+{
+    if (b == 32)
+    {
+        if      (f == SAMPLEFORMAT_UINT) return ((const unsigned int *) p)[i]
+                                              / 4294967295.0f;
+        else if (f == SAMPLEFORMAT_INT)  return ((const int *) p)[i]
+                                              / 2147483647.0f;
+        else                             return ((const float *) p)[i];
+    }
+    else if (b == 16)
+    {
+        const unsigned short *q = (const unsigned short *) p;
+
+        if      (f == SAMPLEFORMAT_IEEEFP) return unhalf(q[i]);
+        else if (f == SAMPLEFORMAT_INT)    return ((const short *) p)[i]
+                                                / 32767.0f;
+        else                               return q[i] / 65535.0f;
+    }
+    else
+    {
+        if      (f == SAMPLEFORMAT_INT)    return ((const signed char *) p)[i]
+                                                / 127.0f;
+        else                               return ((const unsigned char *) p)[i]
+                                                / 255.0f;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Return the 64-bit FNV-1a hash of the contents of the named file, or zero if
+// it cannot be read.
+
+unsigned long long project_hash(const char *path)
+{
+    unsigned long long h = 0;
+    unsigned char      b[65536];
+    FILE              *F;
+    size_t             n;
+    size_t             i;
+
+    if ((F = fopen(path, "rb")))
+    {
+        h = 0xCBF29CE484222325ULL;
+
+        while ((n = fread(b, 1, sizeof (b), F)) > 0)
+            for (i = 0; i < n; i++)
+            {
+                h ^= b[i];
+                h *= 0x100000001B3ULL;
+            }
+
+        fclose(F);
+    }
+    return h;
+}
+
+// Box-filter a W-by-H buffer with rows R bytes apart, or packed if R is zero,
+// and C channels of B bits in sample format F down to fit within M pixels on
+// its longer side. Each preview texel averages the source pixels it covers, so
+// that texel coordinates are source coordinates scaled by PW/W and PH/H
+// exactly. Luminance expands to RGB, and alpha is one where absent. Return the
+// RGBA half buffer and its size.
+
+unsigned short *project_preview(const void *p, size_t r, int w, int h, int c,
+                                int b, int f, int m, int *pw, int *ph)
+{
+    const int s = (w > h) ? w : h;
+
+    unsigned short *q = 0;
+    float          *a = 0;
+
+    int W = (s > m) ? (int) ((long long) w * m / s) : w;
+    int H = (s > m) ? (int) ((long long) h * m / s) : h;
+    int i;
+    int j;
+    int k;
+
+    if (W < 1) W = 1;
+    if (H < 1) H = 1;
+
+    if (r == 0)
+        r = (size_t) w * c * (b / 8);
+
+    if ((q = (unsigned short *) malloc((size_t) W * H * 4 * sizeof (short))) &&
+        (a = (float          *) malloc((size_t) W     * 4 * sizeof (float))))
+    {
+        for (i = 0; i < H; i++)
+        {
+            const int y0 = (int) ((long long)  i      * h / H);
+            const int y1 = (int) ((long long) (i + 1) * h / H);
+
+            memset(a, 0, (size_t) W * 4 * sizeof (float));
+
+            // Sum each source row of this band into its preview texels.
+
+            for (k = y0; k < y1; k++)
+            {
+                const void *l = (const char *) p + (size_t) k * r;
+
+                for (j = 0; j < W; j++)
+                {
+                    const int x0 = (int) ((long long)  j      * w / W);
+                    const int x1 = (int) ((long long) (j + 1) * w / W);
+                    int x;
+
+                    for (x = x0; x < x1; x++)
+                    {
+                        size_t o = (size_t) x * c;
+                        float  v[4];
+
+                        v[0] =             sample(l, b, f, o);
+                        v[1] = (c > 2)   ? sample(l, b, f, o + 1) : v[0];
+                        v[2] = (c > 2)   ? sample(l, b, f, o + 2) : v[0];
+                        v[3] = (c == 4)  ? sample(l, b, f, o + 3) :
+                               (c == 2)  ? sample(l, b, f, o + 1) : 1.0f;
+
+                        a[j * 4 + 0] += v[0];
+                        a[j * 4 + 1] += v[1];
+                        a[j * 4 + 2] += v[2];
+                        a[j * 4 + 3] += v[3];
+                    }
+                }
+            }
+
+            // Normalize the sums and store them.
+
+            for (j = 0; j < W; j++)
+            {
+                const int x0 = (int) ((long long)  j      * w / W);
+                const int x1 = (int) ((long long) (j + 1) * w / W);
+                const float n = (float) (x1 - x0) * (y1 - y0);
+
+                for (k = 0; k < 4; k++)
+                    q[((size_t) i * W + j) * 4 + k] = half(a[j * 4 + k] / n);
+            }
+        }
+
+        *pw = W;
+        *ph = H;
+    }
+    else
+    {
+        free(q);
+        q = 0;
+    }
+
+    free(a);
+    return q;
+}
+
+//------------------------------------------------------------------------------
+
+// Write N project entries to the named file. Return true on success.
+
+int project_save(const char *path, const project_entry *e, int n)
+{
+    FILE *F;
+    int   i;
+    int   j;
+    int   r = 0;
+
+    if ((F = fopen(path, "wb")))
+    {
+        r = fwrite(project_id, 1, 8, F) == 8
+         && put32(F, PROJECT_VERSION)
+         && put32(F, (unsigned int) n);
+
+        for (i = 0; r && i < n; i++)
+        {
+            const size_t l = e[i].path ? strlen(e[i].path) : 0;
+            const size_t s = (size_t) e[i].pw * e[i].ph * 4;
+
+            r = put32(F, (unsigned int) l)
+             && fwrite(e[i].path, 1, l, F) == l
+             && put64(F, e[i].hash)
+             && put32(F, (unsigned int) e[i].w)
+             && put32(F, (unsigned int) e[i].h)
+             && put32(F, (unsigned int) e[i].r[0])
+             && put32(F, (unsigned int) e[i].r[1])
+             && put32(F, (unsigned int) e[i].r[2])
+             && put32(F, (unsigned int) e[i].r[3])
+             && put32(F, (unsigned int) e[i].valuen);
+
+            for (j = 0; r && j < e[i].valuen; j++)
+                r = putf(F, e[i].values[j]);
+
+            r = r && put32(F, (unsigned int) e[i].pw)
+                  && put32(F, (unsigned int) e[i].ph);
+
+            for (j = 0; r && (size_t) j < s; j++)
+            {
+                unsigned char b[2];
+
+                b[0] = (unsigned char) (e[i].preview[j]     );
+                b[1] = (unsigned char) (e[i].preview[j] >> 8);
+
+                r = fwrite(b, 1, 2, F) == 2;
+            }
+        }
+
+        if (fclose(F))
+            r = 0;
+    }
+    return r;
+}
+
+// Read one entry of a version V file. Sizes are checked against sane limits
+// before allocating.
+
+static int load_entry(FILE *F, project_entry *e, unsigned int v)
+{
+    unsigned int l, w, h, n, pw, ph, r[4];
+    size_t       s;
+    size_t       j;
+
+    if (!get32(F, &l) || l > 65536)
+        return 0;
+    if (!(e->path = (char *) calloc(l + 1, 1)) || fread(e->path, 1, l, F) != l)
+        return 0;
+
+    if (!get64(F, &e->hash) || !get32(F, &w) || !get32(F, &h))
+        return 0;
+
+    r[0] = 0;
+    r[1] = 0;
+    r[2] = w;
+    r[3] = h;
+
+    if (v > 1)
+        for (j = 0; j < 4; j++)
+            if (!get32(F, r + j))
+                return 0;
+
+    if (r[2] == 0 || r[0] > w || w - r[0] < r[2] ||
+        r[3] == 0 || r[1] > h || h - r[1] < r[3])
+        return 0;
+
+    if (!get32(F, &n) || n > 1024)
+        return 0;
+
+    e->w      = (int) w;
+    e->h      = (int) h;
+    e->r[0]   = (int) r[0];
+    e->r[1]   = (int) r[1];
+    e->r[2]   = (int) r[2];
+    e->r[3]   = (int) r[3];
+    e->valuen = (int) n;
+
+    if (n && !(e->values = (float *) calloc(n, sizeof (float))))
+        return 0;
+
+    for (j = 0; j < n; j++)
+        if (!getf(F, e->values + j))
+            return 0;
+
+    if (!get32(F, &pw) || !get32(F, &ph) || pw == 0 || ph == 0
+                                         || pw > 65536 || ph > 65536)
+        return 0;
+
+    e->pw = (int) pw;
+    e->ph = (int) ph;
+    s     = (size_t) pw * ph * 4;
+
+    if (!(e->preview = (unsigned short *) malloc(s * sizeof (short))))
+        return 0;
+
+    for (j = 0; j < s; j++)
+    {
+        unsigned char b[2];
+
+        if (fread(b, 1, 2, F) != 2)
+            return 0;
+
+        e->preview[j] = (unsigned short) (b[0] | (b[1] << 8));
+    }
+    return 1;
+}
+
+// Read the named project file. Return its entries and their count, or null if
+// it is damaged. The count is negative if the file is not a project at all.
+
+project_entry *project_load(const char *path, int *n)
+{
+    project_entry *e = 0;
+    unsigned char  id[8];
+    unsigned int   v;
+    unsigned int   c;
+    unsigned int   i;
+    FILE          *F;
+
+    *n = -1;
+
+    if ((F = fopen(path, "rb")))
+    {
+        if (fread(id, 1, 8, F) == 8 && memcmp(id, project_id, 8) == 0)
+        {
+            *n = 0;
+
+            if (get32(F, &v) && 0 < v && v <= PROJECT_VERSION &&
+                get32(F, &c) && c <= 1024 &&
+                (e = (project_entry *) calloc(c ? c : 1,
+                                              sizeof (project_entry))))
+            {
+                for (i = 0; i < c; i++)
+                    if (!load_entry(F, e + i, v))
+                        break;
+
+                if (i == c)
+                    *n = (int) c;
+                else
+                {
+                    project_free(e, (int) i + 1);
+                    e = 0;
+                }
+            }
+        }
+        fclose(F);
+    }
+    return e;
+}
+
+void project_free(project_entry *e, int n)
+{
+    int i;
+
+    if (e)
+    {
+        for (i = 0; i < n; i++)
+        {
+            free(e[i].path);
+            free(e[i].values);
+            free(e[i].preview);
+        }
+        free(e);
+    }
+}
+
+//------------------------------------------------------------------------------
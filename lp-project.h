@@ -0,0 +1,51 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef LP_PROJECT_H
+#define LP_PROJECT_H
+
+//------------------------------------------------------------------------------
+
+// A project entry gives an image's source path and content hash, its full
+// size, the region of it loaded, its values, and a preview of that region with
+// 16-bit float RGBA texels.
+
+struct project_entry
+{
+    char               *path;
+    unsigned long long  hash;
+    int                 w;
+    int                 h;
+    int                 r[4];
+    float              *values;
+    int                 valuen;
+    unsigned short     *preview;
+    int                 pw;
+    int                 ph;
+};
+
+typedef struct project_entry project_entry;
+
+//------------------------------------------------------------------------------
+
+unsigned long long project_hash(const char *);
+
+unsigned short *project_preview(const void *, size_t, int, int, int, int,
+                                int, int, int *, int *);
+
+int            project_save(const char *, const project_entry *, int);
+project_entry *project_load(const char *, int *);
+void           project_free(project_entry *, int);
+
+//------------------------------------------------------------------------------
+
+#endif
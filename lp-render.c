@@ -15,56 +15,338 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <tiffio.h>
 #include <GL/glew.h>
 
 #include "lp-render.h"
 #include "gl-sync.h"
+#include "gl-context.h"
 #include "gl-sphere.h"
 #include "gl-program.h"
 #include "gl-framebuffer.h"
+#include "gl-ktx.h"
+#include "lp-sh.h"
+#include "lp-merge.h"
+#include "lp-project.h"
+#include "lp-page.h"
+#include "lp-tone.h"
+#include "lp-cdf.h"
+#include "lp-light.h"
+#include "lp-gain.h"
 
 //------------------------------------------------------------------------------
 
 #define LP_MAX_IMAGE 8
 
+// Each image stores its exposure in stops after the values of the interface,
+// as binary projects do.
+
+#define IMAGE_EXPOSURE  LP_MAX_VALUE
+#define IMAGE_VALUES   (LP_MAX_VALUE + 1)
+
 #define SPHERE_R 32
 #define SPHERE_C 64
 
+// All render flags selecting a projection of the sphere.
+
+#define LP_RENDER_SPHERE (LP_RENDER_GLOBE | LP_RENDER_CHART | \
+                          LP_RENDER_POLAR | LP_RENDER_CUBE  | LP_RENDER_OCTA)
+
+// All render flags selecting a cube face.
+
+#define LP_RENDER_FACES  (LP_RENDER_CUBE0 | LP_RENDER_CUBE1 | \
+                          LP_RENDER_CUBE2 | LP_RENDER_CUBE3 | \
+                          LP_RENDER_CUBE4 | LP_RENDER_CUBE5)
+
+// Warp maps cached per image, and the default cache budget in megabytes.
+
+#define WARP_MAX    8
+#define WARP_BUDGET 256
+
+// The default render target pool limit in megabytes.
+
+#define POOL_BUDGET 512
+
+// Limit of the longer side of an image preview, in pixels.
+
+#define PREVIEW_MAX 512
+
+// Page atlas budget in megabytes, which is also the texture size beyond which
+// an image is paged, the limit of page uploads per interactive render, and the
+// reduction of the page feedback pass.
+
+#define PAGE_BUDGET  256
+#define PAGE_UPLOADS 32
+#define FEED_SIZE    8
+
+// Rows read back per tile of an export.
+
+#define EXPORT_ROWS 64
+
+// Side of the sphere chart rendered to find the auto-exposure of an LDR export.
+
+#define EXPOSE_SIZE 64
+
+// Side of the grid of accumulation buffer samples of the luminance histogram
+// and mean, and the range of the histogram in stops.
+
+#define STAT_GRID 128
+#define STAT_LO   -16
+#define STAT_HI    16
+
+// Side of the sphere chart on which the exposures of overlapping images are
+// matched.
+
+#define SOLVE_SIZE 64
+
+//------------------------------------------------------------------------------
+
+// A warp map gives the unit disc coordinate and sampling weight of an image at
+// each output pixel. It depends only upon the image's rotation and the view,
+// which are its key, and not upon the image circle, which is applied as the
+// image is sampled.
+
+struct warp
+{
+    gl_framebuffer *buffer;
+    float           rotation[3];
+    int             view[7];
+    unsigned int    time;
+};
+
+typedef struct warp warp;
+
+//------------------------------------------------------------------------------
+
+// A stream decodes a region of an image's source file on a thread of its own,
+// giving the full-resolution buffer, a fresh preview, and the file's content
+// hash. It is freed by its owner once done, or by its own thread if orphaned
+// before then.
+
+struct stream
+{
+    pthread_t           thread;
+    char               *path;
+    void               *p;
+    int                 r[4];
+    int                 w;
+    int                 h;
+    int                 c;
+    int                 b;
+    int                 f;
+    unsigned short     *preview;
+    int                 pw;
+    int                 ph;
+    unsigned long long  hash;
+    page_source        *pages;
+    GLint               page_m;
+    size_t              page_z;
+    int                 done;
+    int                 orphan;
+};
+
+typedef struct stream stream;
+
 //------------------------------------------------------------------------------
 
+// An image's texture may be a preview, with K giving its texels per image
+// pixel, until its full resolution is streamed in from its source file. The
+// preview is kept on the host for saving with a project.
+//
+// An image too large for one texture keeps its preview and is paged instead.
+// Its page table gives the atlas slot of each resident page, with one texel
+// per page of each level, levels stacked in blocks of the level zero grid.
+// Each texel holds the slot column and row, a queued flag, and a resident
+// flag. The table is private to its lightprobe, while the page source is
+// shared.
+
 struct image
 {
     GLuint texture;
     int    w;
     int    h;
-    float  values[LP_MAX_VALUE];
+    int    r[4];
+    float  k[2];
+    float  values[IMAGE_VALUES];
+    warp   warps[WARP_MAX];
+
+    char               *path;
+    unsigned long long  hash;
+    unsigned short     *preview;
+    int                 pw;
+    int                 ph;
+    stream             *stream;
+    int                 pending;
+
+    page_source        *pages;
+    GLuint              table;
+    float              *tablep;
+    int                 tablew;
+    int                 tableh;
+    int                 tabled;
 };
 
 typedef struct image image;
 
+// An atlas slot notes the image and table index of the page it holds, and the
+// render that last wanted it.
+
+struct page_slot
+{
+    int          i;
+    int          k;
+    unsigned int time;
+};
+
+typedef struct page_slot page_slot;
+
+//------------------------------------------------------------------------------
+
+// An export job runs on a worker thread against a snapshot of the images taken
+// when it is queued. It is released by both the caller and the worker.
+
+struct lp_job
+{
+    lp_job   *next;
+    int       refs;
+    int       status;
+    int       cancel;
+    int       steps;
+    int       step;
+
+    int       f;
+    int       s;
+    char     *path;
+    image     images[LP_MAX_IMAGE];
+    int       select;
+    float     clip;
+    float     expo;
+
+    lp_job_fn fn;
+    void     *data;
+};
+
+// A worker thread owns a shared GL context and a lightprobe of its own, with
+// separate framebuffers and programs, and executes a queue of jobs in order.
+
+struct worker
+{
+    pthread_t   thread;
+    gl_context *context;
+    lp_job     *head;
+    lp_job     *tail;
+    lp_job     *job;
+    int         busy;
+    int         quit;
+};
+
+typedef struct worker worker;
+
 //------------------------------------------------------------------------------
 
 struct lightprobe
 {
     // OpenGL support.
 
-    gl_framebuffer tmp;
-    gl_framebuffer acc;
+    gl_pool       *pool;
+    gl_framebuffer *acc;
+    gl_framebuffer *wrp;
     gl_program     circle;
     gl_program     sglobe;
     gl_program     schart;
     gl_program     spolar;
+    gl_program     socta;
     gl_program     sblend;
     gl_program     sfinal;
+    gl_program     sggx;
+    gl_program     sresam;
+    gl_program     sfeed;
+    gl_program     sstat;
+    gl_program     sreduce;
     gl_sphere      sphere;
 
+    GLuint kernel;
     GLuint colormap;
+    GLuint stat_buf;
 
     // Source images.
 
     image images[LP_MAX_IMAGE];
     int   select;
+
+    // Background export. The worker is created on first use. Textures
+    // released while it is busy are kept in the trash until it is idle. The
+    // worker's own lightprobe records the job it is running.
+
+    worker *worker;
+    GLuint *trash;
+    int     trashn;
+    lp_job *job;
+
+    // Warp map cache, with its budget in bytes, current size, bits per
+    // channel, and use counter. The current view is the key of new warps,
+    // which are cached only once it repeats the view of the frame before.
+
+    size_t       cache_max;
+    size_t       cache_len;
+    int          cache_bits;
+    unsigned int cache_time;
+    int          view[7];
+    int          view_still;
+
+    // Render target pool limit, in megabytes.
+
+    int          pool_max;
+
+    // Inverse camera response for bracket merging.
+
+    float       *response;
+    int          responsen;
+
+    // Outlier rejection threshold, in standard deviations.
+
+    float        clip;
+
+    // Crop margin of source images as a fraction of the circle radius, with
+    // zero loading them whole.
+
+    float        crop;
+
+    // Exposure of LDR exports, with zero selecting it automatically.
+
+    float        expo;
+
+    // Page atlas of all paged images, with its budget in megabytes, slots per
+    // side, and slots. Pages wanted by the current render are queued, and the
+    // upload limit of an interactive render defers any beyond it.
+
+    GLuint          atlas;
+    int             atlas_max;
+    int             atlas_n;
+    page_slot      *slots;
+    unsigned short *page_buf;
+    unsigned int    page_time;
+    int            *want;
+    int             wantn;
+    int             wantm;
+    int             page_cap;
+    int             page_wait;
+
+    // Pixel unpack buffer mapped for a caller to fill, with the size, channel
+    // count, and type of the image it will hold.
+
+    GLuint       unpack;
+    void        *mapped;
+    int          mapw;
+    int          maph;
+    int          mapc;
+    int          mapt;
+
+    // Read-back buffer of exports, kept from one to the next.
+
+    void        *band;
+    size_t       bandz;
 };
 
 //------------------------------------------------------------------------------
@@ -81,9 +363,12 @@ static double max(double a, double b)
 
 //------------------------------------------------------------------------------
 // Determine the proper OpenGL interal format, external format, and data type
-// for an image with c channels and b bits per channel.  Punt to c=4 b=8.
+// for an image with c channels, b bits per channel, and TIFF sample format f.
+// An unspecified sample format (f=0) gives 32-bit float and 16-bit unsigned
+// as before. Integer samples are normalized into a floating point texture.
+// Punt to c=4 b=8.
 
-static GLenum internal_form(int b, int c)
+static GLenum internal_form(int b, int c, int f)
 {
     if      (b == 32)
     {
@@ -92,6 +377,13 @@ static GLenum internal_form(int b, int c)
         else if (c == 3) return GL_RGB32F;
         else             return GL_RGBA32F;
     }
+    else if (b == 16 && f == SAMPLEFORMAT_IEEEFP)
+    {
+        if      (c == 1) return GL_R16F;
+        else if (c == 2) return GL_RG16F;
+        else if (c == 3) return GL_RGB16F;
+        else             return GL_RGBA16F;
+    }
     else if (b == 16)
     {
         if      (c == 1) return GL_LUMINANCE16;
@@ -116,88 +408,216 @@ static GLenum external_form(int c)
     else             return GL_RGBA;
 }
 
-static GLenum external_type(int b)
+static GLenum external_type(int b, int f)
 {
-    if      (b == 32) return GL_FLOAT;
-    else if (b == 16) return GL_UNSIGNED_SHORT;
-    else              return GL_UNSIGNED_BYTE;
+    if      (b == 32)
+    {
+        if      (f == SAMPLEFORMAT_UINT)   return GL_UNSIGNED_INT;
+        else if (f == SAMPLEFORMAT_INT)    return GL_INT;
+        else                               return GL_FLOAT;
+    }
+    else if (b == 16)
+    {
+        if      (f == SAMPLEFORMAT_IEEEFP) return GL_HALF_FLOAT;
+        else if (f == SAMPLEFORMAT_INT)    return GL_SHORT;
+        else                               return GL_UNSIGNED_SHORT;
+    }
+    else
+    {
+        if      (f == SAMPLEFORMAT_INT)    return GL_BYTE;
+        else                               return GL_UNSIGNED_BYTE;
+    }
 }
 
 //------------------------------------------------------------------------------
 
 #include "srgb.h"
 
-// Write the contents of an array buffers to a multi-page 32-bit floating point
-// TIFF image.
+// A TIFF sink writes exported tiles to a 32-bit floating point TIFF, or 8-bit
+// for LDR exports, with a page per face and level. The file is created upon
+// the first tile, so that an export stopped before then leaves nothing behind.
 
-static void tifwriten(const char *path, int w, int h, int c, int n, void **p)
+struct lp_tiff
 {
-    TIFF *T = 0;
-    
-    TIFFSetWarningHandler(0);
+    const char *path;
+    TIFF       *T;
+};
+
+typedef struct lp_tiff tifsink;
+
+static void tiftile(const lp_tile *t, void *data)
+{
+    tifsink *S = (tifsink *) data;
+    int      i;
 
-    if ((T = TIFFOpen(path, "w")))
+    if (S->T == 0)
     {
-        uint32 k, i, s;
-        
-        for (k = 0; k < n; ++k)
+        TIFFSetWarningHandler(0);
+        S->T = TIFFOpen(S->path, "w");
+    }
+
+    if (S->T)
+    {
+        if (t->y == 0)
         {
-            TIFFSetField(T, TIFFTAG_IMAGEWIDTH,      w);
-            TIFFSetField(T, TIFFTAG_IMAGELENGTH,     h);
-            TIFFSetField(T, TIFFTAG_BITSPERSAMPLE,  32);
-            TIFFSetField(T, TIFFTAG_SAMPLESPERPIXEL, c);
-        
-            TIFFSetField(T, TIFFTAG_PHOTOMETRIC,  PHOTOMETRIC_RGB);
-            TIFFSetField(T, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
-            TIFFSetField(T, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-            TIFFSetField(T, TIFFTAG_ICCPROFILE,   sRGB_icc_len, sRGB_icc);
+            const int b = (t->type == LP_TYPE_UBYTE) ? 8 : 32;
+
+            TIFFSetField(S->T, TIFFTAG_IMAGEWIDTH,      t->width);
+            TIFFSetField(S->T, TIFFTAG_IMAGELENGTH,     t->height);
+            TIFFSetField(S->T, TIFFTAG_BITSPERSAMPLE,   b);
+            TIFFSetField(S->T, TIFFTAG_SAMPLESPERPIXEL, t->c);
+
+            TIFFSetField(S->T, TIFFTAG_PHOTOMETRIC,  PHOTOMETRIC_RGB);
+            TIFFSetField(S->T, TIFFTAG_SAMPLEFORMAT, (b == 8) ?
+                                                     SAMPLEFORMAT_UINT :
+                                                     SAMPLEFORMAT_IEEEFP);
+            TIFFSetField(S->T, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+            TIFFSetField(S->T, TIFFTAG_ICCPROFILE,   sRGB_icc_len, sRGB_icc);
+        }
 
-            s = (uint32) TIFFScanlineSize(T);
+        for (i = 0; i < t->h; ++i)
+            TIFFWriteScanline(S->T, (uint8 *) t->p + (size_t) i * t->stride,
+                                    t->y + i, 0);
 
-            for (i = 0; i < h; ++i)
-                TIFFWriteScanline(T, (uint8 *) p[k] + (h - i - 1) * s, i, 0);
+        if (t->y + t->h == t->height)
+            TIFFWriteDirectory(S->T);
+    }
+}
 
-            TIFFWriteDirectory(T);
-        }
-        TIFFClose(T);
+// Close a TIFF sink, removing its file if the export was stopped.
+
+static void tifclose(tifsink *S, int stopped)
+{
+    if (S->T)
+    {
+        TIFFClose(S->T);
+
+        if (stopped)
+            remove(S->path);
     }
 }
 
-// Write the contents of a buffer to a 32-bit floating point TIFF image.
+// A sampling sink passes the tiles of a chart on to a TIFF sink, and also
+// builds the importance sampling table of the chart as they pass, in a file
+// named as the TIFF with ".cdf" appended.
 
-static void tifwrite(const char *path, int w, int h, int c, void *p)
+struct cdfsink
 {
-    TIFF *T = 0;
-    
-    TIFFSetWarningHandler(0);
+    tifsink *T;
+    char    *path;
+    cdf     *C;
+};
+
+typedef struct cdfsink cdfsink;
+
+static void cdftile(const lp_tile *t, void *data)
+{
+    cdfsink *S = (cdfsink *) data;
+
+    tiftile(t, S->T);
+
+    if (t->y == 0 && S->C == 0)
+        S->C = cdf_open(S->path, t->width, t->height);
+
+    if (S->C)
+        cdf_rows(S->C, t->p, t->y, t->h, t->stride);
+}
+
+// Ready a sampling sink on TIFF sink T for an export of the given flags to
+// PATH, if they give a float chart. Return zero if they do not, or on failure.
+
+static int cdfinit(cdfsink *S, tifsink *T, int f, const char *path)
+{
+    S->T    = T;
+    S->path = 0;
+    S->C    = 0;
+
+    if ((f & LP_RENDER_CDF) && (f & LP_RENDER_CHART)
+                            && (f & LP_RENDER_LDR) == 0
+                            && (S->path = (char *) malloc(strlen(path) + 5)))
+    {
+        strcat(strcpy(S->path, path), ".cdf");
+        return 1;
+    }
+    return 0;
+}
+
+static void cdffini(cdfsink *S, int stopped)
+{
+    if (S->C)
+        cdf_close(S->C, stopped);
+
+    free(S->path);
+}
+
+// A TIFF sink may also be given to lp_export_data by the caller, and fed later
+// tiles of its own, so that the writing of an export may be deferred or moved
+// to another thread. Tiles of each page must arrive in order.
+
+lp_tiff *lp_tiff_open(const char *path)
+{
+    lp_tiff *S;
+
+    assert(path);
+
+    if ((S = (lp_tiff *) calloc(1, sizeof (lp_tiff) + strlen(path) + 1)))
+        S->path = strcpy((char *) (S + 1), path);
+
+    return S;
+}
+
+void lp_tiff_write(const lp_tile *t, void *data)
+{
+    tiftile(t, data);
+}
+
+// Close a TIFF sink and return true if anything was written.
+
+int lp_tiff_close(lp_tiff *S)
+{
+    int r = 0;
 
-    if ((T = TIFFOpen(path, "w")))
+    if (S)
     {
-        uint32 i, s;
-        
-        TIFFSetField(T, TIFFTAG_IMAGEWIDTH,      w);
-        TIFFSetField(T, TIFFTAG_IMAGELENGTH,     h);
-        TIFFSetField(T, TIFFTAG_BITSPERSAMPLE,  32);
-        TIFFSetField(T, TIFFTAG_SAMPLESPERPIXEL, c);
-        
-        TIFFSetField(T, TIFFTAG_PHOTOMETRIC,  PHOTOMETRIC_RGB);
-        TIFFSetField(T, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
-        TIFFSetField(T, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-        TIFFSetField(T, TIFFTAG_ICCPROFILE,   sRGB_icc_len, sRGB_icc);
+        r = (S->T != 0);
+        tifclose(S, 0);
+        free(S);
+    }
+    return r;
+}
 
-        s = (uint32) TIFFScanlineSize(T);
+// Read the size of a TIFF image without decoding it.
+
+static int tifsize(const char *path, int *w, int *h)
+{
+    TIFF  *T = 0;
+    uint32 W = 0;
+    uint32 H = 0;
 
-        for (i = 0; i < h; ++i)
-            TIFFWriteScanline(T, (uint8 *) p + (h - i - 1) * s, i, 0);
+    TIFFSetWarningHandler(0);
 
+    if ((T = TIFFOpen(path, "r")))
+    {
+        TIFFGetField(T, TIFFTAG_IMAGEWIDTH,  &W);
+        TIFFGetField(T, TIFFTAG_IMAGELENGTH, &H);
         TIFFClose(T);
+
+        *w = (int) W;
+        *h = (int) H;
     }
+    return (W && H);
 }
 
 // Load the contents of a TIFF image to a newly-allocated buffer. Return the
-// buffer and its configuration.
+// buffer and its configuration. Planar-separate images are interleaved one
+// scanline at a time as they are read, giving the same layout as contiguous.
+//
+// If region R is given, as x, y, width, and height, it is clipped to the image
+// and only it is returned. Scanlines are read in order from its first, so only
+// the strips that cover it are decoded. The full size is still returned.
 
-static void *tifread(const char *path, int n, int *w, int *h, int *c, int *b)
+static void *tifread(const char *path, int n, int *r, int *w, int *h,
+                                                      int *c, int *b, int *f)
 {
     TIFF *T = 0;
     void *p = 0;
@@ -208,24 +628,82 @@ static void *tifread(const char *path, int n, int *w, int *h, int *c, int *b)
     {
         if ((n == 0) || TIFFSetDirectory(T, n))
         {
-            uint32 i, s = (uint32) TIFFScanlineSize(T);
-            uint32 W, H;
-            uint16 B, C;
+            uint32 i, j, k, s = (uint32) TIFFScanlineSize(T);
+            uint32 W, H, X0 = 0, Y0 = 0, X, Y;
+            uint16 B, C, P = PLANARCONFIG_CONTIG, F = 0;
 
             TIFFGetField(T, TIFFTAG_IMAGEWIDTH,      &W);
             TIFFGetField(T, TIFFTAG_IMAGELENGTH,     &H);
             TIFFGetField(T, TIFFTAG_BITSPERSAMPLE,   &B);
             TIFFGetField(T, TIFFTAG_SAMPLESPERPIXEL, &C);
+            TIFFGetField(T, TIFFTAG_PLANARCONFIG,    &P);
+            TIFFGetField(T, TIFFTAG_SAMPLEFORMAT,    &F);
+
+            X = W;
+            Y = H;
+
+            if (r)
+            {
+                r[0] = (int) min(max(r[0], 0), W - 1);
+                r[1] = (int) min(max(r[1], 0), H - 1);
+                r[2] = (int) min(max(r[2], 1), W - r[0]);
+                r[3] = (int) min(max(r[3], 1), H - r[1]);
+
+                X0 = (uint32) r[0];
+                Y0 = (uint32) r[1];
+                X  = (uint32) r[2];
+                Y  = (uint32) r[3];
+            }
 
-            if ((p = malloc(H * s)))
-            {         
-                for (i = 0; i < H; ++i)
-                    TIFFReadScanline(T, (uint8 *) p + i * s, i, 0);
+            if (P == PLANARCONFIG_SEPARATE)
+            {
+                const uint32 d = B / 8;
+                const uint32 t = X * C * d;
+                uint8 *q = 0;
+
+                if ((p = malloc(Y * t)) && (q = (uint8 *) malloc(s)))
+                {
+                    for         (k = 0; k < C; ++k)
+                        for     (i = 0; i < Y; ++i)
+                        {
+                            uint8 *o = (uint8 *) p + (i * t) + k * d;
+
+                            TIFFReadScanline(T, q, Y0 + i, (uint16) k);
+
+                            for (j = 0; j < X; ++j)
+                                memcpy(o + j * C * d, q + (X0 + j) * d, d);
+                        }
+                }
+                free(q);
+            }
+            else if (X == W)
+            {
+                if ((p = malloc(Y * s)))
+                    for (i = 0; i < Y; ++i)
+                        TIFFReadScanline(T, (uint8 *) p + i * s, Y0 + i, 0);
+            }
+            else
+            {
+                const uint32 d = B / 8;
+                const uint32 t = X * C * d;
+                uint8 *q = 0;
+
+                if ((p = malloc(Y * t)) && (q = (uint8 *) malloc(s)))
+                    for (i = 0; i < Y; ++i)
+                    {
+                        TIFFReadScanline(T, q, Y0 + i, 0);
+                        memcpy((uint8 *) p + i * t, q + X0 * C * d, t);
+                    }
+                free(q);
+            }
 
+            if (p)
+            {
                 *w = (int) W;
                 *h = (int) H;
                 *b = (int) B;
                 *c = (int) C;
+                *f = (int) F;
             }
         }
         TIFFClose(T);
@@ -233,41 +711,63 @@ static void *tifread(const char *path, int n, int *w, int *h, int *c, int *b)
     return p;
 }
 
-// Load the named TIFF image into a 32-bit floating point OpenGL rectangular
-// texture. Release the image buffer after loading, and return the texture
-// object.
+// Upload a W-by-H image buffer with C channels of B bits each, in TIFF sample
+// format F, to a new OpenGL rectangular texture in its native type. Return the
+// texture object.
 
-unsigned int lp_load_texture(const char *path, int *w, int *h)
+static GLuint upload(const void *p, int w, int h, int c, int b, int f)
 {
     const GLenum T = GL_TEXTURE_RECTANGLE_ARB;
 
+    GLenum i = internal_form(b, c, f);
+    GLenum e = external_form(c);
+    GLenum t = external_type(b, f);
     GLuint o = 0;
-    void  *p = 0;
 
-    int c;
-    int b;
+    glGenTextures(1, &o);
+    glBindTexture(T,  o);
 
-    if ((p = tifread(path, 0, w, h, &c, &b)))
-    {
-        GLenum i = internal_form(b, c);
-        GLenum e = external_form(c);
-        GLenum t = external_type(b);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(T, 0, i, w, h, 0, e, t, p);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(T, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(T, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+    glTexParameteri(T, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+
+    return o;
+}
 
-        glGenTextures(1, &o);
-        glBindTexture(T,  o);
+// Load the named TIFF image into an OpenGL rectangular texture, uploading the
+// samples in their native type. Release the image buffer after loading, and
+// return the texture object.
 
-        glTexImage2D(T, 0, i, *w, *h, 0, e, t, p);
+unsigned int lp_load_texture(const char *path, int *w, int *h)
+{
+    GLuint o = 0;
+    void  *p = 0;
 
-        glTexParameteri(T, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(T, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
-        glTexParameteri(T, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    int c;
+    int b;
+    int f;
 
+    if ((p = tifread(path, 0, 0, w, h, &c, &b, &f)))
+    {
+        o = upload(p, *w, *h, c, b, f);
         free(p);
     }
     return (unsigned int) o;
 }
 
+// Load a KTX cube map, such as one written by lp_export, uploading each of its
+// levels directly. Return the texture object, or zero on failure.
+
+unsigned int lp_load_cubemap(const char *path)
+{
+    return (unsigned int) gl_load_ktx(path);
+}
+
 static GLuint gl_init_colormap(void)
 {
     static const GLubyte p[8][3] = {
@@ -412,576 +912,3783 @@ static void gl_fill_screen(void)
 #include "lp-sglobe-fs.h"
 #include "lp-schart-fs.h"
 #include "lp-spolar-fs.h"
+#include "lp-socta-fs.h"
 #include "lp-sblend-fs.h"
 #include "lp-sfinal-fs.h"
+#include "lp-sggx-fs.h"
+#include "lp-sresam-fs.h"
+#include "lp-sfeed-fs.h"
+#include "lp-sstat-vs.h"
+#include "lp-sstat-fs.h"
+#include "lp-sreduce-fs.h"
+#include "lp-kernel-fs.h"
+
+// Fill a new vertex buffer with a grid of points over the unit square, at the
+// sample centers of the luminance statistics.
+
+static GLuint init_stat(void)
+{
+    GLuint   o;
+    GLfloat *v;
+    int      i;
+    int      j;
+
+    glGenBuffers(1, &o);
+    glBindBuffer(GL_ARRAY_BUFFER, o);
+    glBufferData(GL_ARRAY_BUFFER, STAT_GRID * STAT_GRID * 2 * sizeof (GLfloat),
+                                  0, GL_STATIC_DRAW);
+
+    if ((v = (GLfloat *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY)))
+    {
+        for     (i = 0; i < STAT_GRID; i++)
+            for (j = 0; j < STAT_GRID; j++, v += 2)
+            {
+                v[0] = (j + 0.5f) / STAT_GRID;
+                v[1] = (i + 0.5f) / STAT_GRID;
+            }
+
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return o;
+}
 
 static void gl_init(lightprobe *L)
 {
-    gl_init_framebuffer(&L->tmp, 0, 0, 2);
-    gl_init_framebuffer(&L->acc, 0, 0, 4);
+    L->pool = gl_init_pool((size_t) L->pool_max << 20);
 
     gl_init_program(&L->circle, lp_circle_vs_glsl, lp_circle_vs_glsl_len,
                                 lp_circle_fs_glsl, lp_circle_fs_glsl_len);
-    gl_init_program(&L->sglobe, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
-                                lp_sglobe_fs_glsl, lp_sglobe_fs_glsl_len);
-    gl_init_program(&L->schart, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
-                                lp_schart_fs_glsl, lp_schart_fs_glsl_len);
-    gl_init_program(&L->spolar, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
-                                lp_spolar_fs_glsl, lp_spolar_fs_glsl_len);
-    gl_init_program(&L->sblend, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
-                                lp_sblend_fs_glsl, lp_sblend_fs_glsl_len);
+
+    // The coordinate, blending, feedback, filtering, and resampling passes
+    // share the projection kernel.
+
+    L->kernel = gl_load_fshader(lp_kernel_h, lp_kernel_h_len);
+
+    gl_init_library(&L->sglobe, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
+                                lp_sglobe_fs_glsl, lp_sglobe_fs_glsl_len,
+                                L->kernel);
+    gl_init_library(&L->schart, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
+                                lp_schart_fs_glsl, lp_schart_fs_glsl_len,
+                                L->kernel);
+    gl_init_library(&L->spolar, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
+                                lp_spolar_fs_glsl, lp_spolar_fs_glsl_len,
+                                L->kernel);
+    gl_init_library(&L->socta,  lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
+                                lp_socta_fs_glsl,  lp_socta_fs_glsl_len,
+                                L->kernel);
+    gl_init_library(&L->sblend, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
+                                lp_sblend_fs_glsl, lp_sblend_fs_glsl_len,
+                                L->kernel);
     gl_init_program(&L->sfinal, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
                                 lp_sfinal_fs_glsl, lp_sfinal_fs_glsl_len);
+    gl_init_library(&L->sggx,   lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
+                                lp_sggx_fs_glsl,   lp_sggx_fs_glsl_len,
+                                L->kernel);
+    gl_init_library(&L->sresam, lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
+                                lp_sresam_fs_glsl, lp_sresam_fs_glsl_len,
+                                L->kernel);
+    gl_init_library(&L->sfeed,  lp_sphere_vs_glsl, lp_sphere_vs_glsl_len,
+                                lp_sfeed_fs_glsl,  lp_sfeed_fs_glsl_len,
+                                L->kernel);
+    gl_init_program(&L->sstat,  lp_sstat_vs_glsl,  lp_sstat_vs_glsl_len,
+                                lp_sstat_fs_glsl,  lp_sstat_fs_glsl_len);
+    gl_init_program(&L->sreduce, lp_sphere_vs_glsl,  lp_sphere_vs_glsl_len,
+                                 lp_sreduce_fs_glsl, lp_sreduce_fs_glsl_len);
 
     gl_init_sphere(&L->sphere, SPHERE_R, SPHERE_C);
 
     L->colormap = gl_init_colormap();
+    L->stat_buf = init_stat();
 }
 
+static void free_atlas(lightprobe *);
+
 static void gl_free(lightprobe *L)
 {
+    free_atlas(L);
+
+    if (L->mapped)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, L->unpack);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    if (L->unpack)
+        glDeleteBuffers(1, &L->unpack);
+
+    L->unpack = 0;
+    L->mapped = 0;
+
+    free(L->band);
+
+    L->band  = 0;
+    L->bandz = 0;
+
     gl_free_colormap(L->colormap);
+    glDeleteBuffers(1, &L->stat_buf);
 
     gl_free_sphere(&L->sphere);
 
+    gl_free_program(&L->sreduce);
+    gl_free_program(&L->sstat);
+    gl_free_program(&L->sfeed);
+    gl_free_program(&L->sresam);
+    gl_free_program(&L->sggx);
     gl_free_program(&L->sfinal);
     gl_free_program(&L->sblend);
+    gl_free_program(&L->socta);
+    gl_free_program(&L->spolar);
     gl_free_program(&L->schart);
     gl_free_program(&L->sglobe);
     gl_free_program(&L->circle);
 
-    gl_free_framebuffer(&L->acc);
-    gl_free_framebuffer(&L->tmp);
-}
+    glDeleteShader(L->kernel);
 
-//------------------------------------------------------------------------------
-// Allocate and initialize a new, empty lightprobe object. Initialize all GL
-// state needed to operate upon the input and render the output.
-//
-// GLEW initialization has to go somewhere, and it might as well go here. It
-// would be ugly to require the user to call it, and it shouldn't hurt to do it
-// multiple times.
+    L->kernel = 0;
 
-lightprobe *lp_init()
-{
-    lightprobe *L = 0;
+    gl_free_pool(L->pool);
 
-    glewInit();
-    sync(1);
+    L->pool = 0;
+    L->acc  = 0;
+    L->wrp  = 0;
+}
 
-    if ((L = (lightprobe *) calloc (1, sizeof (lightprobe))))
-        gl_init(L);
+//------------------------------------------------------------------------------
 
-    return L;
+static size_t warp_size(const warp *W)
+{
+    return (size_t) W->buffer->w * W->buffer->h * W->buffer->c
+                                                 * W->buffer->b / 8;
 }
 
-// Bounce the GLSL state of the given lightprobe. This is useful during GLSL
-// development
+// Return a warp map's buffer to the pool, if it has one.
 
-void lp_tilt(lightprobe *L)
+static void free_warp(lightprobe *L, warp *W)
 {
-    gl_free(L);
-    gl_init(L);
+    if (W->buffer)
+    {
+        L->cache_len -= warp_size(W);
+        gl_put_framebuffer(L->pool, W->buffer);
+        memset(W, 0, sizeof (warp));
+    }
 }
 
-// Release a lightprobe object and all state associated with it. Unload any
-// images and delete all OpenGL state.
+// Release all warp maps of an image.
 
-void lp_free(lightprobe *L)
+static void free_warps(lightprobe *L, image *I)
 {
-    int i;
+    int j;
 
-    assert(L);
+    for (j = 0; j < WARP_MAX; j++)
+        free_warp(L, I->warps + j);
+}
 
-    for (i = 0; i < LP_MAX_IMAGE; i++)
-        lp_del_image(L, i);
+// Release the least-recently used warp maps of all images until N more bytes
+// fit the budget. Return false if they cannot.
 
-    gl_free(L);
-    free(L);
+static int trim_warps(lightprobe *L, size_t n)
+{
+    while (L->cache_len + n > L->cache_max)
+    {
+        warp *W = 0;
+        int   i;
+        int   j;
+
+        for     (i = 0; i < LP_MAX_IMAGE; i++)
+            for (j = 0; j < WARP_MAX;     j++)
+                if (L->images[i].warps[j].buffer)
+                    if (W == 0 || L->images[i].warps[j].time < W->time)
+                        W = L->images[i].warps + j;
+        if (W)
+            free_warp(L, W);
+        else
+            return 0;
+    }
+    return 1;
 }
 
 //------------------------------------------------------------------------------
 
-int lp_add_image(lightprobe *L, const char *path)
+// Return true if a W-by-H image with C channels of B bits should be paged,
+// either as its texture exceeds size limit M or byte budget Z.
+
+static int paged(GLint m, size_t z, int w, int h, int c, int b)
 {
-    GLuint o = 0;
-    int    i = 0;
-    int    w = 0;
-    int    h = 0;
+    return (w > m || h > m || (size_t) w * h * c * b / 8 > z);
+}
 
-    assert(L);
-    assert(path);
+static void page_limits(lightprobe *L, GLint *m, size_t *z)
+{
+    *m = 0;
+    *z = (size_t) L->atlas_max << 20;
 
-    // Load the texture.
+    glGetIntegerv(GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB, m);
+}
 
-    if ((o = lp_load_texture(path, &w, &h)))
-    {
-        // Find the lightprobe's first unused image slot.
+// Release one reference to a page source. Hold the job lock.
 
-        for (i = 0; i < LP_MAX_IMAGE; i++)
-            if (L->images[i].texture == 0)
-            {
-                // Store the texture.
+static void unref_pages(page_source *P)
+{
+    if (P && --P->refs == 0)
+        page_free(P);
+}
 
-                L->images[i].texture = o;
-                L->images[i].w       = w;
-                L->images[i].h       = h;
+// Release the page table of image I, along with any atlas slots it holds.
 
-                // Set some default values.
+static void free_table(lightprobe *L, int i)
+{
+    image *I = L->images + i;
+    int    k;
 
-                L->images[i].values[LP_CIRCLE_X]      = w / 2;
-                L->images[i].values[LP_CIRCLE_Y]      = h / 2;
-                L->images[i].values[LP_CIRCLE_RADIUS] = h / 3;
+    if (I->table)
+        glDeleteTextures(1, &I->table);
 
-                // Succeed.
+    free(I->tablep);
 
-                return i;
+    I->table  = 0;
+    I->tablep = 0;
+    I->tablew = 0;
+    I->tableh = 0;
+    I->tabled = 0;
+
+    for (k = 0; k < L->atlas_n * L->atlas_n; k++)
+        if (L->slots[k].i == i)
+            L->slots[k].i = -1;
+}
+
+// Release the atlas, and with it every page table.
+
+static void free_atlas(lightprobe *L)
+{
+    int i;
+
+    for (i = 0; i < LP_MAX_IMAGE; i++)
+        free_table(L, i);
+
+    if (L->atlas)
+        glDeleteTextures(1, &L->atlas);
+
+    free(L->slots);
+    free(L->page_buf);
+    free(L->want);
+
+    L->atlas    = 0;
+    L->atlas_n  = 0;
+    L->slots    = 0;
+    L->page_buf = 0;
+    L->want     = 0;
+    L->wantn    = 0;
+    L->wantm    = 0;
+}
+
+// Create the atlas at the largest square of slots within its budget and the
+// texture size limit.
+
+static int init_atlas(lightprobe *L)
+{
+    const GLenum T = GL_TEXTURE_RECTANGLE_ARB;
+
+    GLint m = 0;
+    int   n;
+    int   k;
+
+    if (L->atlas == 0)
+    {
+        glGetIntegerv(GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB, &m);
+
+        n = (int) sqrt((double) ((size_t) L->atlas_max << 20)
+                     / (PAGE_STRIDE * PAGE_STRIDE * 8));
+
+        if (n > m / PAGE_STRIDE) n = m / PAGE_STRIDE;
+        if (n < 1)               n = 1;
+
+        L->slots    = (page_slot      *) malloc(n * n * sizeof (page_slot));
+        L->page_buf = (unsigned short *) malloc(PAGE_STRIDE * PAGE_STRIDE
+                                                * 4 * sizeof (short));
+        if (L->slots && L->page_buf)
+        {
+            for (k = 0; k < n * n; k++)
+            {
+                L->slots[k].i    = -1;
+                L->slots[k].k    =  0;
+                L->slots[k].time =  0;
             }
+            L->atlas_n = n;
 
-        // Fail.
+            glGenTextures(1, &L->atlas);
+            glBindTexture(T,  L->atlas);
+            glTexImage2D (T, 0, GL_RGBA16F, n * PAGE_STRIDE, n * PAGE_STRIDE,
+                          0, GL_RGBA, GL_HALF_FLOAT, NULL);
 
-        glDeleteTextures(1, &o);
+            glTexParameteri(T, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(T, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+            glTexParameteri(T, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+        }
+        else free_atlas(L);
     }
-    return -1;
+    return (L->atlas != 0);
 }
 
-void lp_del_image(lightprobe *L, int i)
+// Create the page table of image I, with every page absent.
+
+static int init_table(lightprobe *L, int i)
 {
-    int j;
+    const GLenum T = GL_TEXTURE_RECTANGLE_ARB;
 
-    assert(L);
-    assert(0 <= i && i < LP_MAX_IMAGE);
+    image *I = L->images + i;
 
-    // Release the image.
+    if (I->table == 0 && init_atlas(L))
+    {
+        const int w = (I->pages->w[0] + PAGE_SIZE - 1) / PAGE_SIZE;
+        const int h = (I->pages->h[0] + PAGE_SIZE - 1) / PAGE_SIZE;
+        const int n =  I->pages->n;
 
-    if (L->images[i].texture)
+        if ((I->tablep = (float *) calloc((size_t) w * h * n * 4,
+                                          sizeof (float))))
+        {
+            I->tablew = w;
+            I->tableh = h;
+
+            glGenTextures(1, &I->table);
+            glBindTexture(T,  I->table);
+            glTexImage2D (T, 0, GL_RGBA32F, w, h * n, 0,
+                          GL_RGBA, GL_FLOAT, I->tablep);
+
+            glTexParameteri(T, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(T, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+            glTexParameteri(T, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+        }
+    }
+    return (I->table != 0);
+}
+
+// Note that page X, Y of level D of image I is wanted by the current render.
+// Mark it used if resident, or else queue it once.
+
+static void want_page(lightprobe *L, int i, int d, int x, int y)
+{
+    image *I = L->images + i;
+
+    if (0 <= d && d < I->pages->n &&
+        0 <= x && x * PAGE_SIZE < I->pages->w[d] &&
+        0 <= y && y * PAGE_SIZE < I->pages->h[d])
     {
-        glDeleteTextures(1, &L->images[i].texture);
-        memset(L->images + i, 0, sizeof (image));
+        const int k = (d * I->tableh + y) * I->tablew + x;
+        float    *e = I->tablep + k * 4;
+
+        if (e[3] > 0.0f)
+            L->slots[(int) e[1] * L->atlas_n + (int) e[0]].time = L->page_time;
+
+        else if (e[2] == 0.0f)
+        {
+            const int m = L->wantm * 2 + 64;
+
+            int *w;
+
+            if (L->wantn == L->wantm &&
+                (w = (int *) realloc(L->want, m * sizeof (int))))
+            {
+                L->want  = w;
+                L->wantm = m;
+            }
+            if (L->wantn < L->wantm)
+            {
+                L->want[L->wantn++] = k;
+                e[2] = 1.0f;
+            }
+        }
     }
+}
 
-    // Select another image, if possible.
+// Claim an empty atlas slot, or the least-recently used one not wanted by the
+// current render, evicting its page from its image's table. Return -1 if all
+// slots are wanted.
 
-    if (L->select == i)
-        for (j = 0; j < LP_MAX_IMAGE; j++)
-            lp_sel_image(L, j);
+static int claim_slot(lightprobe *L)
+{
+    int s = -1;
+    int k;
+
+    for (k = 0; k < L->atlas_n * L->atlas_n; k++)
+    {
+        if (L->slots[k].i < 0)
+            return k;
+
+        if (L->slots[k].time != L->page_time)
+            if (s < 0 || L->slots[k].time < L->slots[s].time)
+                s = k;
+    }
+
+    if (s >= 0)
+    {
+        image *J = L->images + L->slots[s].i;
+
+        memset(J->tablep + L->slots[s].k * 4, 0, 4 * sizeof (float));
+        J->tabled    = 1;
+        L->slots[s].i = -1;
+    }
+    return s;
 }
 
-void lp_sel_image(lightprobe *L, int i)
+// Upload the queued pages of image I, coarsest level first, so that a limited
+// upload still covers as much of the view as possible. Pages that fit neither
+// the atlas nor the upload limit fall back to coarser pages or the preview.
+
+static void load_pages(lightprobe *L, int i)
 {
-    assert(L);
-    assert(0 <= i && i < LP_MAX_IMAGE);
+    const GLenum T = GL_TEXTURE_RECTANGLE_ARB;
 
-    if (L->images[i].texture)
-        L->select = i;
+    image *I = L->images + i;
+    int    d;
+    int    j;
+    int    n = 0;
+
+    glBindTexture(T, L->atlas);
+
+    for     (d = I->pages->n - 1; d >= 0; d--)
+        for (j = 0; j < L->wantn; j++)
+        {
+            const int k = L->want[j];
+            const int x = (k % I->tablew);
+            const int y = (k / I->tablew) % I->tableh;
+            float    *e = I->tablep + k * 4;
+            int       s;
+
+            if ((k / I->tablew) / I->tableh == d)
+            {
+                e[2] = 0.0f;
+
+                if (L->page_cap && n == L->page_cap)
+                    L->page_wait++;
+
+                else if ((s = claim_slot(L)) >= 0)
+                {
+                    const int sx = s % L->atlas_n;
+                    const int sy = s / L->atlas_n;
+
+                    page_copy(I->pages, d, x, y, L->page_buf);
+
+                    glTexSubImage2D(T, 0, sx * PAGE_STRIDE, sy * PAGE_STRIDE,
+                                          PAGE_STRIDE, PAGE_STRIDE,
+                                          GL_RGBA, GL_HALF_FLOAT, L->page_buf);
+
+                    L->slots[s].i    = i;
+                    L->slots[s].k    = k;
+                    L->slots[s].time = L->page_time;
+
+                    e[0] = (float) sx;
+                    e[1] = (float) sy;
+                    e[3] = 1.0f;
+
+                    I->tabled = 1;
+                    n++;
+                }
+            }
+        }
+
+    L->wantn = 0;
 }
 
 //------------------------------------------------------------------------------
 
-int lp_get_width(lightprobe *L)
+// All job state is guarded by one lock, and any change is broadcast.
+
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  job_cond  = PTHREAD_COND_INITIALIZER;
+
+// Release one reference to a job, freeing it with the last. Hold the lock.
+
+static void release(lp_job *J)
 {
-    assert(L);
-    return (L->images[L->select].texture) ? L->images[L->select].w : 0;
+    int i;
+
+    if (--J->refs == 0)
+    {
+        for (i = 0; i < LP_MAX_IMAGE; i++)
+            unref_pages(J->images[i].pages);
+
+        free(J->path);
+        free(J);
+    }
 }
 
-int lp_get_height(lightprobe *L)
+// Return true if the job being run by the given lightprobe has been cancelled.
+
+static int stopped(lightprobe *L)
 {
-    assert(L);
-    return (L->images[L->select].texture) ? L->images[L->select].h : 0;
+    int c = 0;
+
+    if (L->job)
+    {
+        pthread_mutex_lock(&job_mutex);
+        c = L->job->cancel;
+        pthread_mutex_unlock(&job_mutex);
+    }
+    return c;
 }
 
-float lp_get_value(lightprobe *L, int k)
+// Note the completion of one rendering pass of the job being run by the given
+// lightprobe. Finish the pass first, so that progress reflects GPU work.
+
+static void step(lightprobe *L)
 {
-    assert(L);
-    assert(0 <= k && k < LP_MAX_VALUE);
-    return (L->images[L->select].texture) ? L->images[L->select].values[k] : 0;
+    if (L->job)
+    {
+        glFinish();
+
+        pthread_mutex_lock(&job_mutex);
+        L->job->step++;
+        pthread_mutex_unlock(&job_mutex);
+    }
 }
 
-void  lp_set_value(lightprobe *L, int k, float v)
+// Delete a texture, or defer its deletion if a queued or running job might
+// still be reading it.
+
+static void discard(lightprobe *L, GLuint o)
 {
-    assert(L);
-    assert(0 <= k && k < LP_MAX_VALUE);
-    if (L->images[L->select].texture)
-        L->images[L->select].values[k] = v;
+    GLuint *t;
+    int     b = 0;
+
+    if (L->worker)
+    {
+        pthread_mutex_lock(&job_mutex);
+        b = L->worker->busy;
+        pthread_mutex_unlock(&job_mutex);
+    }
+
+    if (b && (t = (GLuint *) realloc(L->trash, (L->trashn + 1)
+                                               * sizeof (GLuint))))
+    {
+        L->trash = t;
+        L->trash[L->trashn++] = o;
+    }
+    else glDeleteTextures(1, &o);
+}
+
+// Delete all deferred textures, if the worker has become idle.
+
+static void flush(lightprobe *L)
+{
+    int b = 0;
+
+    if (L->trashn)
+    {
+        if (L->worker)
+        {
+            pthread_mutex_lock(&job_mutex);
+            b = L->worker->busy;
+            pthread_mutex_unlock(&job_mutex);
+        }
+
+        if (b == 0)
+        {
+            glDeleteTextures(L->trashn, L->trash);
+            free(L->trash);
+            L->trash  = 0;
+            L->trashn = 0;
+        }
+    }
 }
 
 //------------------------------------------------------------------------------
 
-static void proj_image(int vx, int vy, int vw, int vh, int ww, int wh)
+// Stream state is guarded by a lock of its own, and completion is broadcast.
+
+static pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  load_cond  = PTHREAD_COND_INITIALIZER;
+
+static void free_stream(stream *S)
 {
-    glOrtho(vx, vx + ww, vy + wh, vy, 0, 1);
+    if (S->pages)
+        page_free(S->pages);
+
+    free(S->preview);
+    free(S->path);
+    free(S->p);
+    free(S);
 }
 
-static void proj_globe(int vx, int vy, int vw, int vh, int ww, int wh)
+// Hash and decode the requested region of the source file and make its
+// preview, and its pages if it is too large for a texture.
+
+static void *load(void *p)
 {
-    double z = (double) ww / (double) vw;
+    stream *S = (stream *) p;
+    int     o;
 
-    glFrustum(-0.5 * z * ww / wh,
-              +0.5 * z * ww / wh,
-              -0.5 * z,
-              +0.5 * z, 0.25, 10.0);
+    S->hash = project_hash(S->path);
+
+    if ((S->p = tifread(S->path, 0, S->r, &S->w, &S->h, &S->c,
+                                                        &S->b, &S->f)))
+    {
+        const int w = S->r[2];
+        const int h = S->r[3];
+
+        S->preview = project_preview(S->p, 0, w, h, S->c, S->b, S->f,
+                                     PREVIEW_MAX, &S->pw, &S->ph);
+
+        if (paged(S->page_m, S->page_z, w, h, S->c, S->b))
+        {
+            S->pages = page_init(S->p, 0, w, h, S->c, S->b, S->f);
+            free(S->p);
+            S->p = 0;
+        }
+    }
+
+    pthread_mutex_lock(&load_mutex);
+    {
+        S->done = 1;
+        o = S->orphan;
+        pthread_cond_broadcast(&load_cond);
+    }
+    pthread_mutex_unlock(&load_mutex);
+
+    if (o)
+        free_stream(S);
+
+    return 0;
 }
 
-static void proj_polar(int vx, int vy, int vw, int vh, int ww, int wh)
+// Begin streaming region R of the named file.
+
+static stream *init_stream(lightprobe *L, const char *path, const int *r)
 {
-    glOrtho(vx, vx + ww, vy + wh, vy, 0, 1);
+    stream *S;
+
+    if ((S = (stream *) calloc(1, sizeof (stream))))
+    {
+        if ((S->path = (char *) malloc(strlen(path) + 1)))
+        {
+            strcpy(S->path, path);
+            memcpy(S->r, r, sizeof (S->r));
+            page_limits(L, &S->page_m, &S->page_z);
+
+            if (pthread_create(&S->thread, 0, load, S) == 0)
+            {
+                pthread_detach(S->thread);
+                return S;
+            }
+            free(S->path);
+        }
+        free(S);
+    }
+    return 0;
 }
 
-static void proj_chart(int vx, int vy, int vw, int vh, int ww, int wh)
+// Abandon a stream, leaving it to free itself if it is still running.
+
+static void drop_stream(stream *S)
 {
-    glOrtho(vx, vx + ww, vy + wh, vy, 0, 1);
+    int d;
+
+    pthread_mutex_lock(&load_mutex);
+    {
+        if ((d = S->done) == 0)
+            S->orphan = 1;
+    }
+    pthread_mutex_unlock(&load_mutex);
+
+    if (d)
+        free_stream(S);
+}
+
+// Return true if a stream is done, waiting for it if requested.
+
+static int wait_stream(stream *S, int b)
+{
+    int d;
+
+    pthread_mutex_lock(&load_mutex);
+    {
+        while ((d = S->done) == 0 && b)
+            pthread_cond_wait(&load_cond, &load_mutex);
+    }
+    pthread_mutex_unlock(&load_mutex);
+
+    return d;
+}
+
+// Find the bounding box of the circle of image I, grown by M times its radius
+// and clipped to the image.
+
+static void circle_rect(const image *I, float m, int *r)
+{
+    const double x = I->values[LP_CIRCLE_X];
+    const double y = I->values[LP_CIRCLE_Y];
+    const double d = I->values[LP_CIRCLE_RADIUS] * (1.0 + m);
+
+    const int x0 = (int) max(floor(x - d), 0);
+    const int y0 = (int) max(floor(y - d), 0);
+    const int x1 = (int) min(ceil (x + d), I->w);
+    const int y1 = (int) min(ceil (y + d), I->h);
+
+    r[0] = x0;
+    r[1] = y0;
+    r[2] = (x1 > x0) ? x1 - x0 : 1;
+    r[3] = (y1 > y0) ? y1 - y0 : 1;
+}
+
+// Return true if the loaded region of image I covers its circle.
+
+static int covers(const image *I)
+{
+    int r[4];
+
+    circle_rect(I, 0.0f, r);
+
+    return (I->r[0]           <= r[0]        &&
+            I->r[1]           <= r[1]        &&
+            I->r[0] + I->r[2] >= r[0] + r[2] &&
+            I->r[1] + I->r[3] >= r[1] + r[3]);
+}
+
+// Let a texture covering a cropped region give nothing beyond it.
+
+static void crop_texture(GLuint o)
+{
+    static const GLfloat c[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    const GLenum T = GL_TEXTURE_RECTANGLE_ARB;
+
+    glBindTexture   (T, o);
+    glTexParameteri (T, GL_TEXTURE_WRAP_S,       GL_CLAMP_TO_BORDER);
+    glTexParameteri (T, GL_TEXTURE_WRAP_T,       GL_CLAMP_TO_BORDER);
+    glTexParameterfv(T, GL_TEXTURE_BORDER_COLOR, c);
+}
+
+// Bring a previewed image to full resolution. Begin streaming it if need be,
+// and upload the result once done, waiting for it if requested. Warp maps are
+// kept, as they do not depend upon the texture. A source that has changed
+// since its project was saved is still loaded, with a warning, and one that
+// cannot be read leaves the preview in place.
+//
+// In crop mode, only the region around the image circle is streamed. It is
+// streamed again if the circle has since left it.
+
+static void fetch(lightprobe *L, image *I, int b)
+{
+    const int i = (int) (I - L->images);
+
+    stream *S;
+    int     r[4];
+
+    if (I->pending && I->stream == 0)
+    {
+        r[0] = 0;
+        r[1] = 0;
+        r[2] = I->w;
+        r[3] = I->h;
+
+        if (L->crop > 0.0f)
+            circle_rect(I, L->crop, r);
+
+        I->stream = init_stream(L, I->path, r);
+    }
+
+    if ((S = I->stream) && wait_stream(S, b))
+    {
+        if ((S->p || S->pages) && S->preview && S->w == I->w && S->h == I->h)
+        {
+            if (I->hash && I->hash != S->hash)
+                fprintf(stderr, "%s has changed\n", I->path);
+
+            discard(L, I->texture);
+            free_table(L, i);
+            free(I->preview);
+
+            pthread_mutex_lock(&job_mutex);
+            unref_pages(I->pages);
+            pthread_mutex_unlock(&job_mutex);
+
+            if (S->pages)
+            {
+                I->texture = upload(S->preview, S->pw, S->ph, 4, 16,
+                                    SAMPLEFORMAT_IEEEFP);
+                I->k[0]    = (float) S->pw / S->r[2];
+                I->k[1]    = (float) S->ph / S->r[3];
+                I->pages   = S->pages;
+                S->pages   = 0;
+            }
+            else
+            {
+                I->texture = upload(S->p, S->r[2], S->r[3], S->c, S->b, S->f);
+                I->k[0]    = 1.0f;
+                I->k[1]    = 1.0f;
+                I->pages   = 0;
+            }
+            if (S->r[2] < I->w || S->r[3] < I->h)
+                crop_texture(I->texture);
+
+            memcpy(I->r, S->r, sizeof (I->r));
+
+            I->hash    = S->hash;
+            I->preview = S->preview;
+            I->pw      = S->pw;
+            I->ph      = S->ph;
+
+            S->preview = 0;
+        }
+        else fprintf(stderr, "%s could not be loaded\n", I->path);
+
+        free_stream(S);
+
+        I->stream  = 0;
+        I->pending = (L->crop > 0.0f && !covers(I));
+    }
 }
 
-static void proj_cube(void)
-{
-    glFrustum(+0.5, -0.5, -0.5, +0.5, 0.5, 5.0);
+// Fetch all images used by a render with the given flags.
+
+static void fetch_images(lightprobe *L, int f, int b)
+{
+    int i;
+
+    if (f & LP_RENDER_ALL)
+    {
+        for (i = 0; i < LP_MAX_IMAGE; i++)
+            if (L->images[i].texture)
+                fetch(L, L->images + i, b);
+    }
+    else if (L->images[L->select].texture)
+        fetch(L, L->images + L->select, b);
+}
+
+//------------------------------------------------------------------------------
+
+// Run the worker thread. Bind the shared context, build a private lightprobe
+// within it, and export each job in turn against that job's image snapshot.
+// The completion callback is called on this thread.
+
+static void *work(void *p)
+{
+    worker     *W = (worker *) p;
+    lightprobe *L;
+    lp_job     *J;
+    int         i;
+
+    gl_bind_context(W->context, 1);
+
+    if ((L = (lightprobe *) calloc(1, sizeof (lightprobe))))
+    {
+        L->cache_max  = (size_t) WARP_BUDGET << 20;
+        L->cache_bits = 32;
+        L->pool_max   = POOL_BUDGET;
+        L->atlas_max  = PAGE_BUDGET;
+        gl_init(L);
+    }
+
+    pthread_mutex_lock(&job_mutex);
+
+    while (1)
+    {
+        while (W->head == 0 && W->quit == 0)
+            pthread_cond_wait(&job_cond, &job_mutex);
+
+        if ((J = W->head) == 0)
+            break;
+
+        if ((W->head = J->next) == 0)
+             W->tail = 0;
+
+        // Export unless cancelled while queued.
+
+        if (J->cancel == 0 && L)
+        {
+            J->status = LP_JOB_RUNNING;
+            W->job    = J;
+            pthread_mutex_unlock(&job_mutex);
+            {
+                // Warp maps depend only upon rotation and view, which are
+                // their key, so each slot keeps its warps from job to job.
+
+                for (i = 0; i < LP_MAX_IMAGE; i++)
+                    memcpy(J->images[i].warps, L->images[i].warps,
+                                        sizeof (L->images[i].warps));
+
+                memcpy(L->images, J->images, sizeof (L->images));
+                L->select = J->select;
+                L->clip   = J->clip;
+                L->expo   = J->expo;
+                L->job    = J;
+
+                lp_export(L, J->f, J->s, J->path);
+                glFinish();
+
+                for (i = 0; i < LP_MAX_IMAGE; i++)
+                    free_table(L, i);
+
+                L->job    = 0;
+            }
+            pthread_mutex_lock(&job_mutex);
+            W->job    = 0;
+        }
+        J->status = J->cancel ? LP_JOB_CANCELLED : LP_JOB_DONE;
+        W->busy--;
+
+        pthread_mutex_unlock(&job_mutex);
+        {
+            if (J->fn)
+                J->fn(J, J->data);
+        }
+        pthread_mutex_lock(&job_mutex);
+
+        pthread_cond_broadcast(&job_cond);
+        release(J);
+    }
+
+    pthread_mutex_unlock(&job_mutex);
+
+    // The image textures belong to the caller.
+
+    if (L)
+    {
+        for (i = 0; i < LP_MAX_IMAGE; i++)
+            free_warps(L, L->images + i);
+
+        memset(L->images, 0, sizeof (L->images));
+        gl_free(L);
+        free(L);
+    }
+
+    gl_bind_context(W->context, 0);
+
+    return 0;
+}
+
+// Start a worker thread with a context sharing the current one.
+
+static worker *init_worker(void)
+{
+    worker *W;
+
+    if ((W = (worker *) calloc(1, sizeof (worker))))
+    {
+        if ((W->context = gl_init_context()))
+        {
+            if (pthread_create(&W->thread, 0, work, W) == 0)
+                return W;
+
+            gl_free_context(W->context);
+        }
+        free(W);
+    }
+    return 0;
+}
+
+// Cancel all of a worker's jobs and wait for its thread to exit.
+
+static void free_worker(worker *W)
+{
+    lp_job *J;
+
+    pthread_mutex_lock(&job_mutex);
+    {
+        for (J = W->head; J; J = J->next)
+            J->cancel = 1;
+
+        if (W->job)
+            W->job->cancel = 1;
+
+        W->quit = 1;
+        pthread_cond_broadcast(&job_cond);
+    }
+    pthread_mutex_unlock(&job_mutex);
+
+    pthread_join(W->thread, 0);
+
+    gl_free_context(W->context);
+    free(W);
+}
+
+//------------------------------------------------------------------------------
+// Allocate and initialize a new, empty lightprobe object. Initialize all GL
+// state needed to operate upon the input and render the output.
+//
+// GLEW initialization has to go somewhere, and it might as well go here. It
+// would be ugly to require the user to call it, and it shouldn't hurt to do it
+// multiple times.
+
+lightprobe *lp_init()
+{
+    lightprobe *L = 0;
+
+    glewInit();
+    sync(1);
+
+    if ((L = (lightprobe *) calloc (1, sizeof (lightprobe))))
+    {
+        L->cache_max  = (size_t) WARP_BUDGET << 20;
+        L->cache_bits = 32;
+        L->pool_max   = POOL_BUDGET;
+        L->atlas_max  = PAGE_BUDGET;
+        L->clip       = 1.0f;
+        gl_init(L);
+    }
+    return L;
+}
+
+// Bounce the GLSL state of the given lightprobe. This is useful during GLSL
+// development
+
+void lp_tilt(lightprobe *L)
+{
+    int i;
+
+    for (i = 0; i < LP_MAX_IMAGE; i++)
+        free_warps(L, L->images + i);
+
+    gl_free(L);
+    gl_init(L);
+}
+
+// Release a lightprobe object and all state associated with it. Unload any
+// images and delete all OpenGL state.
+
+void lp_free(lightprobe *L)
+{
+    int i;
+
+    assert(L);
+
+    if (L->worker)
+        free_worker(L->worker);
+
+    L->worker = 0;
+
+    for (i = 0; i < LP_MAX_IMAGE; i++)
+        lp_del_image(L, i);
+
+    flush(L);
+
+    gl_free(L);
+    free(L->response);
+    free(L);
+}
+
+//------------------------------------------------------------------------------
+
+// Store a W-by-H texture in the lightprobe's first unused image slot, and
+// return its index. Delete the texture and return -1 if there is none.
+
+static int add_texture(lightprobe *L, GLuint o, int w, int h)
+{
+    int i;
+
+    if (o)
+    {
+        for (i = 0; i < LP_MAX_IMAGE; i++)
+            if (L->images[i].texture == 0)
+            {
+                // Store the texture.
+
+                L->images[i].texture = o;
+                L->images[i].w       = w;
+                L->images[i].h       = h;
+                L->images[i].r[2]    = w;
+                L->images[i].r[3]    = h;
+                L->images[i].k[0]    = 1.0f;
+                L->images[i].k[1]    = 1.0f;
+
+                // Set some default values.
+
+                L->images[i].values[LP_CIRCLE_X]      = w / 2;
+                L->images[i].values[LP_CIRCLE_Y]      = h / 2;
+                L->images[i].values[LP_CIRCLE_RADIUS] = h / 3;
+
+                // Succeed.
+
+                return i;
+            }
+
+        // Fail.
+
+        glDeleteTextures(1, &o);
+    }
+    return -1;
+}
+
+// Add a W-by-H buffer with rows R bytes apart, or packed if R is zero, and C
+// channels of B bits in TIFF sample format F, with its preview. Upload it
+// directly, or page it if it is too large for a single texture, with the
+// preview as its texture. If the buffer is the mapping of pixel unpack buffer
+// U, unmap it and upload from there. Return its index, or -1.
+
+static int add_buffer(lightprobe *L, const void *p, size_t r, int w, int h,
+                                     int c, int b, int f, GLuint u)
+{
+    unsigned short *q = 0;
+    page_source    *P = 0;
+    GLuint          o = 0;
+    GLint           m;
+    size_t          z;
+    int             pw;
+    int             ph;
+    int             i;
+
+    page_limits(L, &m, &z);
+
+    if ((q = project_preview(p, r, w, h, c, b, f, PREVIEW_MAX, &pw, &ph)))
+        if (paged(m, z, w, h, c, b))
+            P = page_init(p, r, w, h, c, b, f);
+
+    if (u)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, u);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (q)
+    {
+        if (P)
+            o = upload(q, pw, ph, 4, 16, SAMPLEFORMAT_IEEEFP);
+        else
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, u);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint) (r / (c * b / 8)));
+            o = upload(u ? 0 : p, w, h, c, b, f);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+    }
+
+    if ((i = add_texture(L, o, w, h)) >= 0)
+    {
+        image *I = L->images + i;
+
+        I->preview = q;
+        I->pw      = pw;
+        I->ph      = ph;
+
+        if ((I->pages = P))
+        {
+            I->k[0] = (float) pw / w;
+            I->k[1] = (float) ph / h;
+        }
+    }
+    else
+    {
+        if (P) page_free(P);
+        free(q);
+    }
+    return i;
+}
+
+// Give the bits and TIFF sample format of sample type T. Return false if T is
+// unknown.
+
+static int type_form(int t, int *b, int *f)
+{
+    switch (t)
+    {
+    case LP_TYPE_UBYTE:  *b =  8; *f = SAMPLEFORMAT_UINT;   return 1;
+    case LP_TYPE_BYTE:   *b =  8; *f = SAMPLEFORMAT_INT;    return 1;
+    case LP_TYPE_USHORT: *b = 16; *f = SAMPLEFORMAT_UINT;   return 1;
+    case LP_TYPE_SHORT:  *b = 16; *f = SAMPLEFORMAT_INT;    return 1;
+    case LP_TYPE_HALF:   *b = 16; *f = SAMPLEFORMAT_IEEEFP; return 1;
+    case LP_TYPE_UINT:   *b = 32; *f = SAMPLEFORMAT_UINT;   return 1;
+    case LP_TYPE_INT:    *b = 32; *f = SAMPLEFORMAT_INT;    return 1;
+    case LP_TYPE_FLOAT:  *b = 32; *f = SAMPLEFORMAT_IEEEFP; return 1;
+    }
+    return 0;
+}
+
+// Give the sample type of B bits in TIFF sample format F, as read by tifread.
+
+static int form_type(int b, int f)
+{
+    if      (b == 32)
+    {
+        if      (f == SAMPLEFORMAT_IEEEFP) return LP_TYPE_FLOAT;
+        else if (f == SAMPLEFORMAT_INT)    return LP_TYPE_INT;
+        else                               return LP_TYPE_UINT;
+    }
+    else if (b == 16)
+    {
+        if      (f == SAMPLEFORMAT_IEEEFP) return LP_TYPE_HALF;
+        else if (f == SAMPLEFORMAT_INT)    return LP_TYPE_SHORT;
+        else                               return LP_TYPE_USHORT;
+    }
+    else
+    {
+        if      (f == SAMPLEFORMAT_INT)    return LP_TYPE_BYTE;
+        else                               return LP_TYPE_UBYTE;
+    }
+}
+
+// Decode the named TIFF image to a new buffer, for lp_add_image_data, giving
+// its size, channel count, and sample type. This needs no GL context, so that
+// images may be decoded on any thread. Return null on failure.
+
+void *lp_read_image(const char *path, int *w, int *h, int *c, int *t)
+{
+    void *p;
+    int   b;
+    int   f;
+
+    assert(path);
+
+    if ((p = tifread(path, 0, 0, w, h, c, &b, &f)))
+        *t = form_type(b, f);
+
+    return p;
+}
+
+// Add a W-by-H image held in caller memory, with C channels of sample type T
+// and rows S bytes apart, or packed if S is zero. S must be a whole number of
+// pixels. The image is uploaded straight from P, with nothing copied but its
+// preview. Once done with P, successfully or not, call FN with DATA, if given.
+// Return the image's index, or -1.
+
+int lp_add_image_data(lightprobe *L, const void *p, int w, int h, int c,
+                      int t, int s, lp_release_fn fn, void *data)
+{
+    int b;
+    int f;
+    int i = -1;
+
+    assert(L);
+    assert(p);
+
+    if (w > 0 && h > 0 && 0 < c && c <= 4 && type_form(t, &b, &f))
+    {
+        const int z = c * b / 8;
+
+        if (s == 0 || (s >= w * z && s % z == 0))
+            i = add_buffer(L, p, (size_t) s, w, h, c, b, f, 0);
+    }
+
+    if (fn)
+        fn(data);
+
+    return i;
+}
+
+// Replace image I with one held in caller memory, as lp_add_image_data adds it,
+// keeping the values of I. The warp maps of I depend only upon its rotation and
+// the view, so they pass to the replacement, which suits a sequence of frames
+// from a fixed rig. Return the index of the replacement, which differs from I
+// if a slot is free, or -1. On failure I remains, unless no slot was free.
+
+int lp_swap_image_data(lightprobe *L, int i, const void *p, int w, int h,
+                       int c, int t, int s, lp_release_fn fn, void *data)
+{
+    float v[IMAGE_VALUES];
+    int   j;
+    int   k;
+    int   q;
+
+    assert(L);
+    assert(0 <= i && i < LP_MAX_IMAGE);
+
+    if (L->images[i].texture == 0)
+        return lp_add_image_data(L, p, w, h, c, t, s, fn, data);
+
+    memcpy(v, L->images[i].values, sizeof (v));
+
+    q = (L->select == i);
+
+    // Upload the replacement beside I if there is room, else in its place.
+
+    for (k = 0; k < LP_MAX_IMAGE; k++)
+        if (L->images[k].texture == 0)
+            break;
+
+    if (k == LP_MAX_IMAGE)
+        lp_del_image(L, i);
+
+    if ((j = lp_add_image_data(L, p, w, h, c, t, s, fn, data)) >= 0)
+    {
+        image *I = L->images + i;
+        image *J = L->images + j;
+
+        memcpy(J->values, v, sizeof (v));
+
+        if (j != i)
+        {
+            memcpy(J->warps, I->warps, sizeof (I->warps));
+            memset(I->warps, 0,        sizeof (I->warps));
+
+            lp_del_image(L, i);
+        }
+        if (q)
+            L->select = j;
+    }
+    return j;
+}
+
+// Map a pixel unpack buffer large enough for a packed W-by-H image with C
+// channels of sample type T, and return it for the caller to fill. The image is
+// added by lp_add_image_mapped, and uploaded from the buffer without passing
+// through client memory. Return null on failure, or if a buffer is already
+// mapped.
+
+void *lp_map_image_data(lightprobe *L, int w, int h, int c, int t)
+{
+    int b;
+    int f;
+
+    assert(L);
+
+    if (L->mapped == 0 && w > 0 && h > 0 && 0 < c && c <= 4
+                       && type_form(t, &b, &f))
+    {
+        if (L->unpack == 0)
+            glGenBuffers(1, &L->unpack);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, L->unpack);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr) w * h * c * b / 8,
+                     0, GL_STREAM_DRAW);
+
+        // The buffer is read back once to make the preview, so map it for
+        // reading as well as writing.
+
+        if ((L->mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_READ_WRITE)))
+        {
+            L->mapw = w;
+            L->maph = h;
+            L->mapc = c;
+            L->mapt = t;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    return L->mapped;
+}
+
+// Unmap the buffer given by lp_map_image_data and add the image it holds.
+// Return its index, or -1.
+
+int lp_add_image_mapped(lightprobe *L)
+{
+    int b;
+    int f;
+    int i = -1;
+
+    assert(L);
+
+    if (L->mapped && type_form(L->mapt, &b, &f))
+        i = add_buffer(L, L->mapped, 0, L->mapw, L->maph, L->mapc, b, f,
+                       L->unpack);
+
+    L->mapped = 0;
+    return i;
+}
+
+// Load the named TIFF image and add it, noting its path. In crop mode, read
+// only its header, and leave it to be streamed when first rendered, by which
+// time its circle is known.
+
+int lp_add_image(lightprobe *L, const char *path)
+{
+    void *p = 0;
+    int   w = 0;
+    int   h = 0;
+    int   c;
+    int   b;
+    int   f;
+    int   i = -1;
+
+    assert(L);
+    assert(path);
+
+    if (L->crop > 0.0f)
+    {
+        static const unsigned char z[4] = { 0, 0, 0, 0 };
+
+        if (tifsize(path, &w, &h))
+            if ((i = add_texture(L, upload(z, 1, 1, 4, 8, SAMPLEFORMAT_UINT),
+                                 w, h)) >= 0)
+            {
+                image *I = L->images + i;
+
+                if ((I->path = (char *) malloc(strlen(path) + 1)))
+                {
+                    strcpy(I->path, path);
+                    memset(I->r, 0, sizeof (I->r));
+                    I->pending = 1;
+                }
+            }
+    }
+    else if ((p = tifread(path, 0, 0, &w, &h, &c, &b, &f)))
+    {
+        if ((i = lp_add_image_data(L, p, w, h, c, form_type(b, f), 0,
+                                   free, p)) >= 0)
+        {
+            image *I = L->images + i;
+
+            if ((I->path = (char *) malloc(strlen(path) + 1)))
+                strcpy(I->path, path);
+        }
+    }
+    return i;
+}
+
+// Merge N bracketed 8 or 16-bit exposures of one view to a radiance image and
+// add it. T gives the exposure times, or any values proportional to them. The
+// images must agree in size and format. The merge uses the response curve
+// given by lp_set_response. A merged image has no one source, so a project
+// keeps only its preview.
+
+int lp_add_bracket(lightprobe *L, const char **path, const float *t, int n)
+{
+    void **p;
+    float *q = 0;
+    int    w = 0;
+    int    h = 0;
+    int    c = 0;
+    int    b = 0;
+    int    f = 0;
+    int    i = -1;
+    int    k;
+
+    assert(L);
+    assert(path);
+    assert(t);
+
+    if ((p = (void **) calloc(n, sizeof (void *))))
+    {
+        // Read all exposures, checking their agreement.
+
+        for (k = 0; k < n; k++)
+        {
+            int W, H, C, B, F;
+
+            if ((p[k] = tifread(path[k], 0, 0, &W, &H, &C, &B, &F)) == 0)
+                break;
+
+            if (k == 0)
+            {
+                w = W;
+                h = H;
+                c = C;
+                b = B;
+                f = F;
+            }
+            else if (W != w || H != h || C != c || B != b || F != f)
+                break;
+        }
+
+        // Merge them and add the result.
+
+        if (k == n && (f == 0 || f == SAMPLEFORMAT_UINT))
+            if ((q = merge_bracket((const void **) p, t, n, w, h, c, b,
+                                   L->response, L->responsen)))
+                i = add_buffer(L, q, 0, w, h, c, 32, SAMPLEFORMAT_IEEEFP, 0);
+
+        for (k = 0; k < n; k++)
+            free(p[k]);
+
+        free(p);
+        free(q);
+    }
+    return i;
+}
+
+// Set the inverse camera response curve used to merge brackets: N samples
+// mapping pixel values uniformly spaced over the full range to relative
+// linear exposure. Null selects the default, sRGB for 8-bit and linear for
+// 16-bit.
+
+void lp_set_response(lightprobe *L, const float *g, int n)
+{
+    assert(L);
+
+    free(L->response);
+
+    L->response  = 0;
+    L->responsen = 0;
+
+    if (g && n > 1 && (L->response = (float *) malloc(n * sizeof (float))))
+    {
+        memcpy(L->response, g, n * sizeof (float));
+        L->responsen = n;
+    }
+}
+
+void lp_del_image(lightprobe *L, int i)
+{
+    int j;
+
+    assert(L);
+    assert(0 <= i && i < LP_MAX_IMAGE);
+
+    // Release the image.
+
+    if (L->images[i].texture)
+    {
+        if (L->images[i].stream)
+            drop_stream(L->images[i].stream);
+
+        free_warps(L, L->images + i);
+        free_table(L, i);
+        discard(L, L->images[i].texture);
+        free(L->images[i].preview);
+        free(L->images[i].path);
+
+        pthread_mutex_lock(&job_mutex);
+        unref_pages(L->images[i].pages);
+        pthread_mutex_unlock(&job_mutex);
+
+        memset(L->images + i, 0, sizeof (image));
+    }
+
+    // Select another image, if possible.
+
+    if (L->select == i)
+        for (j = 0; j < LP_MAX_IMAGE; j++)
+            lp_sel_image(L, j);
+}
+
+void lp_sel_image(lightprobe *L, int i)
+{
+    assert(L);
+    assert(0 <= i && i < LP_MAX_IMAGE);
+
+    if (L->images[i].texture)
+        L->select = i;
+}
+
+//------------------------------------------------------------------------------
+
+// Write all images to the named project file, with their source paths, content
+// hashes, values, and previews, and the regions that the previews cover.
+// Images yet to be loaded are loaded first. Return true on success.
+
+int lp_save_project(lightprobe *L, const char *path)
+{
+    project_entry e[LP_MAX_IMAGE];
+    int           i;
+    int           n = 0;
+
+    assert(L);
+    assert(path);
+
+    memset(e, 0, sizeof (e));
+
+    fetch_images(L, LP_RENDER_ALL, 1);
+
+    for (i = 0; i < LP_MAX_IMAGE; i++)
+    {
+        image *I = L->images + i;
+
+        if (I->texture && I->preview)
+        {
+            if (I->path && I->hash == 0)
+                I->hash = project_hash(I->path);
+
+            e[n].path    = I->path;
+            e[n].hash    = I->hash;
+            e[n].w       = I->w;
+            e[n].h       = I->h;
+            e[n].values  = I->values;
+            memcpy(e[n].r, I->r, sizeof (e[n].r));
+            e[n].valuen  = IMAGE_VALUES;
+            e[n].preview = I->preview;
+            e[n].pw      = I->pw;
+            e[n].ph      = I->ph;
+            n++;
+        }
+    }
+    return project_save(path, e, n);
+}
+
+// Add all images of the named project file. Each appears at once as its
+// preview, and its full resolution is streamed in when first rendered. Values
+// missing from an older project keep their defaults. Return the number of
+// images added, or -1 if the file is not a project.
+
+int lp_load_project(lightprobe *L, const char *path)
+{
+    project_entry *e;
+    int            i;
+    int            j;
+    int            k;
+    int            n;
+    int            c = 0;
+
+    assert(L);
+    assert(path);
+
+    if ((e = project_load(path, &n)))
+    {
+        for (k = 0; k < n; k++)
+        {
+            GLuint o = upload(e[k].preview, e[k].pw, e[k].ph, 4, 16,
+                              SAMPLEFORMAT_IEEEFP);
+
+            if ((i = add_texture(L, o, e[k].w, e[k].h)) >= 0)
+            {
+                image *I = L->images + i;
+
+                for (j = 0; j < e[k].valuen && j < IMAGE_VALUES; j++)
+                    I->values[j] = e[k].values[j];
+
+                memcpy(I->r, e[k].r, sizeof (I->r));
+
+                if (I->r[2] < I->w || I->r[3] < I->h)
+                    crop_texture(I->texture);
+
+                I->k[0]    = (float) e[k].pw / e[k].r[2];
+                I->k[1]    = (float) e[k].ph / e[k].r[3];
+                I->hash    = e[k].hash;
+                I->preview = e[k].preview;
+                I->pw      = e[k].pw;
+                I->ph      = e[k].ph;
+
+                if (e[k].path[0])
+                {
+                    I->path    = e[k].path;
+                    I->pending = 1;
+                    e[k].path  = 0;
+                }
+                e[k].preview = 0;
+
+                if (c++ == 0)
+                    lp_sel_image(L, i);
+            }
+        }
+        project_free(e, n);
+    }
+    return (n < 0) ? -1 : c;
+}
+
+// Return the source path of the given image, empty if it has none, or null if
+// there is no such image.
+
+const char *lp_get_path(lightprobe *L, int i)
+{
+    assert(L);
+    assert(0 <= i && i < LP_MAX_IMAGE);
+
+    if (L->images[i].texture)
+        return L->images[i].path ? L->images[i].path : "";
+    else
+        return 0;
+}
+
+// Return the number of image slots, the bound of every image index.
+
+int lp_get_images(lightprobe *L)
+{
+    assert(L);
+    return LP_MAX_IMAGE;
+}
+
+// Return the number of images whose full resolution is streaming in, plus the
+// number of pages deferred by the last render. Each appears at the next render
+// after it arrives.
+
+int lp_get_pending(lightprobe *L)
+{
+    int i;
+    int n = L->page_wait;
+
+    assert(L);
+
+    for (i = 0; i < LP_MAX_IMAGE; i++)
+        if (L->images[i].stream)
+            n++;
+
+    return n;
+}
+
+//------------------------------------------------------------------------------
+
+int lp_get_width(lightprobe *L)
+{
+    assert(L);
+    return (L->images[L->select].texture) ? L->images[L->select].w : 0;
+}
+
+int lp_get_height(lightprobe *L)
+{
+    assert(L);
+    return (L->images[L->select].texture) ? L->images[L->select].h : 0;
+}
+
+float lp_get_value(lightprobe *L, int k)
+{
+    assert(L);
+    assert(0 <= k && k < LP_MAX_VALUE);
+    return (L->images[L->select].texture) ? L->images[L->select].values[k] : 0;
+}
+
+void  lp_set_value(lightprobe *L, int k, float v)
+{
+    assert(L);
+    assert(0 <= k && k < LP_MAX_VALUE);
+    if (L->images[L->select].texture)
+    {
+        image *I = L->images + L->select;
+
+        // A change of rotation invalidates the image's warp maps.
+
+        if (I->values[k] != v && (k == LP_SPHERE_ELEVATION ||
+                                  k == LP_SPHERE_AZIMUTH   ||
+                                  k == LP_SPHERE_ROLL))
+            free_warps(L, I);
+
+        I->values[k] = v;
+
+        // A cropped image whose circle has left its region is reloaded.
+
+        if (L->crop > 0.0f && I->path && I->stream == 0 && !covers(I))
+            I->pending = 1;
+    }
+}
+
+// Get and set the exposure of the selected image in stops, as matched by
+// lp_solve_exposure.
+
+float lp_get_gain(lightprobe *L)
+{
+    assert(L);
+    return (L->images[L->select].texture) ?
+            L->images[L->select].values[IMAGE_EXPOSURE] : 0;
+}
+
+void  lp_set_gain(lightprobe *L, float g)
+{
+    assert(L);
+    if (L->images[L->select].texture)
+        L->images[L->select].values[IMAGE_EXPOSURE] = g;
+}
+
+// Set the render target pool limit in megabytes. Targets in use are kept
+// regardless, and idle ones are freed least-recently used first.
+
+void lp_set_pool(lightprobe *L, int m)
+{
+    assert(L);
+    assert(m >= 0);
+
+    L->pool_max = m;
+    gl_size_pool(L->pool, (size_t) m << 20);
+}
+
+// Report the number of render target requests met from the pool, the number
+// that allocated, and the pool's current size in megabytes.
+
+void lp_get_pool(lightprobe *L, int *hits, int *misses, int *m)
+{
+    unsigned int h;
+    unsigned int n;
+    size_t       z;
+
+    assert(L);
+
+    gl_stat_pool(L->pool, &h, &n, &z);
+
+    if (hits)   *hits   = (int) h;
+    if (misses) *misses = (int) n;
+    if (m)      *m      = (int) ((z + (1 << 20) - 1) >> 20);
+}
+
+// Set the page atlas budget in megabytes. Images whose textures would exceed
+// it, or the texture size limit, are paged when next loaded. All pages are
+// dropped, to be paged in again at the new size.
+
+void lp_set_pages(lightprobe *L, int m)
+{
+    assert(L);
+    assert(m > 0);
+
+    L->atlas_max = m;
+    free_atlas(L);
+}
+
+// Set the outlier rejection threshold of the clipped blend, in standard
+// deviations of log luminance from the weighted mean.
+
+void lp_set_clip(lightprobe *L, float k)
+{
+    assert(L);
+    L->clip = k;
+}
+
+// Set the crop margin of source images, as a fraction of the circle radius.
+// Images added while it is positive load only the region around the circle,
+// and reload should the circle move beyond it. Zero loads them whole.
+
+void lp_set_crop(lightprobe *L, float m)
+{
+    assert(L);
+    assert(m >= 0.0f);
+    L->crop = m;
+}
+
+// Set the exposure of LDR exports, as given to lp_render. Zero selects the
+// exposure that brings the log-average luminance of the sphere to middle grey.
+
+void lp_set_exposure(lightprobe *L, float e)
+{
+    assert(L);
+    assert(e >= 0.0f);
+    L->expo = e;
+}
+
+// Set the warp map cache budget in megabytes, with zero disabling the cache,
+// and the precision of cached maps in bits per channel, 16 or 32.
+
+void lp_set_cache(lightprobe *L, int m, int b)
+{
+    int i;
+
+    assert(L);
+    assert(m >= 0);
+    assert(b == 16 || b == 32);
+
+    L->cache_max = (size_t) m << 20;
+
+    if (L->cache_bits != b)
+    {
+        for (i = 0; i < LP_MAX_IMAGE; i++)
+            free_warps(L, L->images + i);
+
+        L->cache_bits = b;
+    }
+    trim_warps(L, 0);
+}
+
+//------------------------------------------------------------------------------
+
+static void proj_image(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    glOrtho(vx, vx + ww, vy + wh, vy, 0, 1);
+}
+
+static void proj_globe(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    double z = (double) ww / (double) vw;
+
+    glFrustum(-0.5 * z * ww / wh,
+              +0.5 * z * ww / wh,
+              -0.5 * z,
+              +0.5 * z, 0.25, 10.0);
+}
+
+static void proj_polar(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    glOrtho(vx, vx + ww, vy + wh, vy, 0, 1);
+}
+
+static void proj_chart(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    glOrtho(vx, vx + ww, vy + wh, vy, 0, 1);
+}
+
+static void proj_octa(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    glOrtho(vx, vx + ww, vy + wh, vy, 0, 1);
+}
+
+static void proj_cube(void)
+{
+    glFrustum(+0.5, -0.5, -0.5, +0.5, 0.5, 5.0);
+}
+
+static void view_globe(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    double x = (double) vx / max(1, vw - ww);
+    double y = (double) vy / max(1, vh - wh);
+
+    glRotated(180 * y -  90, 1, 0, 0);
+    glRotated(360 * x - 180, 0, 1, 0);
+}
+
+static void view_chart(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    double k = min(0.5 * vw, vh);
+
+    glScaled(2 * k, k, 1);
+}
+
+static void view_polar(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    double x = 0.5 * vw;
+    double y = 0.5 * vh;
+    double k = min(x, y);
+
+    glTranslated(x, y, 0);
+    glScaled    (k, k, 1);
+}
+
+static void view_octa(int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    double x = 0.5 * vw;
+    double y = 0.5 * vh;
+    double k = min(x, y);
+
+    glTranslated(x, y, 0);
+    glScaled    (k, k, 1);
+}
+
+static void view_cube(int i)
+{
+    switch (i)
+    {
+    case 0: glRotated(+90, 0, 1, 0);                          break;
+    case 1: glRotated(-90, 0, 1, 0);                          break;
+    case 2: glRotated(-90, 1, 0, 0); glRotated(180, 0, 1, 0); break;
+    case 3: glRotated(+90, 1, 0, 0); glRotated(180, 0, 1, 0); break;
+    case 4: glRotated(180, 0, 1, 0);                          break;
+    }
+}
+
+static void transform(int f, int vx, int vy, int vw, int vh, int ww, int wh)
+{
+    glViewport(0, 0, ww, wh);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+
+    if      (f & LP_RENDER_GLOBE) proj_globe(vx, vy, vw, vh, ww, wh);
+    else if (f & LP_RENDER_CHART) proj_chart(vx, vy, vw, vh, ww, wh);
+    else if (f & LP_RENDER_POLAR) proj_polar(vx, vy, vw, vh, ww, wh);
+    else if (f & LP_RENDER_OCTA)  proj_octa (vx, vy, vw, vh, ww, wh);
+    else if (f & LP_RENDER_CUBE0) proj_cube();
+    else if (f & LP_RENDER_CUBE1) proj_cube();
+    else if (f & LP_RENDER_CUBE2) proj_cube();
+    else if (f & LP_RENDER_CUBE3) proj_cube();
+    else if (f & LP_RENDER_CUBE4) proj_cube();
+    else if (f & LP_RENDER_CUBE5) proj_cube();
+    else                          proj_image(vx, vy, vw, vh, ww, wh);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    if      (f & LP_RENDER_GLOBE) view_globe(vx, vy, vw, vh, ww, wh);
+    else if (f & LP_RENDER_CHART) view_chart(vx, vy, vw, vh, ww, wh);
+    else if (f & LP_RENDER_POLAR) view_polar(vx, vy, vw, vh, ww, wh);
+    else if (f & LP_RENDER_OCTA)  view_octa (vx, vy, vw, vh, ww, wh);
+    else if (f & LP_RENDER_CUBE0) view_cube(0);
+    else if (f & LP_RENDER_CUBE1) view_cube(1);
+    else if (f & LP_RENDER_CUBE2) view_cube(2);
+    else if (f & LP_RENDER_CUBE3) view_cube(3);
+    else if (f & LP_RENDER_CUBE4) view_cube(4);
+    else if (f & LP_RENDER_CUBE5) view_cube(5);
+}
+
+//------------------------------------------------------------------------------
+
+// Exchange pooled framebuffer F for one of the given size, if it differs.
+
+static gl_framebuffer *resize(lightprobe *L, gl_framebuffer *F,
+                              int w, int h, int c)
+{
+    if (F && F->w == w && F->h == h && F->c == c)
+        return F;
+
+    gl_put_framebuffer(L->pool, F);
+
+    return gl_get_framebuffer(L->pool, w, h, c, 32);
+}
+
+// Find or render the warp map of the given image for the current view, at the
+// size of its window. The coordinate pass writes unit disc coordinates along
+// with their sampling weight, found from screen-space derivatives. A warp is
+// kept per projection, window size, and rotation, and is rendered again when
+// the viewport pans or zooms. While the view changes from frame to frame, as
+// during a drag, the scratch buffer is used instead, and the view is cached
+// once it holds still. A new warp takes a buffer from the pool and claims the
+// image's least-recently used cache slot, or uses the scratch buffer if it
+// does not fit.
+
+static gl_framebuffer *draw_swarp(lightprobe *L, image *I, int m)
+{
+    const int    w = L->view[5];
+    const int    h = L->view[6];
+    const size_t n = (size_t) w * h * 3 * L->cache_bits / 8;
+
+    gl_framebuffer *F = 0;
+    warp           *W = 0;
+    GLuint          P;
+    int             j;
+
+    for (j = 0; j < WARP_MAX; j++)
+    {
+        warp *V = I->warps + j;
+
+        if (V->buffer && V->view[0] == L->view[0]
+                      && V->view[5] == L->view[5]
+                      && V->view[6] == L->view[6]
+                      && V->rotation[0] == I->values[LP_SPHERE_ELEVATION]
+                      && V->rotation[1] == I->values[LP_SPHERE_AZIMUTH]
+                      && V->rotation[2] == I->values[LP_SPHERE_ROLL])
+        {
+            W = V;
+            break;
+        }
+        if (W == 0 || V->time < W->time)
+            W = V;
+    }
+
+    if (W->buffer && memcmp(W->view, L->view, sizeof (L->view)) == 0
+                  && W->rotation[0] == I->values[LP_SPHERE_ELEVATION]
+                  && W->rotation[1] == I->values[LP_SPHERE_AZIMUTH]
+                  && W->rotation[2] == I->values[LP_SPHERE_ROLL])
+    {
+        W->time = ++L->cache_time;
+        return W->buffer;
+    }
+
+    if (L->view_still)
+    {
+        if (j == WARP_MAX)
+            free_warp(L, W);
+
+        if (W->buffer == 0 && n && trim_warps(L, n))
+        {
+            W->buffer     = gl_get_framebuffer(L->pool, w, h, 3, L->cache_bits);
+            L->cache_len += n;
+        }
+    }
+
+    if (L->view_still && W->buffer)
+    {
+        memcpy(W->view, L->view, sizeof (L->view));
+
+        W->rotation[0] = I->values[LP_SPHERE_ELEVATION];
+        W->rotation[1] = I->values[LP_SPHERE_AZIMUTH];
+        W->rotation[2] = I->values[LP_SPHERE_ROLL];
+        W->time        = ++L->cache_time;
+
+        F = W->buffer;
+    }
+    else F = L->wrp = resize(L, L->wrp, w, h, 3);
+
+    // Set up the sphere transform for this image.
+
+    glMatrixMode(GL_TEXTURE);
+    {
+        glLoadIdentity();
+        glRotatef(I->values[LP_SPHERE_ROLL],       0.0f, 0.0f, 1.0f);
+        glRotatef(I->values[LP_SPHERE_ELEVATION], -1.0f, 0.0f, 0.0f);
+        glRotatef(I->values[LP_SPHERE_AZIMUTH],    0.0f, 1.0f, 0.0f);
+    }
+    glMatrixMode(GL_MODELVIEW);
+
+    // Render unit disc coordinates and weights to the warp map.
+
+    glBindFramebuffer(GL_FRAMEBUFFER, F->frame);
+
+    if      (m == GL_SPHERE_CHART) P = L->schart.program;
+    else if (m == GL_SPHERE_POLAR) P = L->spolar.program;
+    else if (m == GL_SPHERE_OCTA)  P = L->socta.program;
+    else                           P = L->sglobe.program;
+
+    glUseProgram(P);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBlendFunc(GL_ONE, GL_ZERO);
+    gl_fill_sphere(&L->sphere, m);
+
+    return F;
+}
+
+// Set the page uniforms of program P for image I and bind its page table and
+// the atlas, uploading the table if it has changed. An unpaged image has no
+// levels, and samples its texture.
+
+static void bind_pages(lightprobe *L, const gl_program *P, image *I)
+{
+    const GLenum T = GL_TEXTURE_RECTANGLE_ARB;
+
+    GLfloat k[PAGE_LEVELS][2];
+    int     l;
+    int     n = 0;
+
+    if (I->pages && I->table)
+    {
+        n = I->pages->n;
+
+        for (l = 0; l < n; l++)
+        {
+            k[l][0] = (GLfloat) I->pages->w[l] / I->pages->w[0];
+            k[l][1] = (GLfloat) I->pages->h[l] / I->pages->h[0];
+        }
+
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(T, I->table);
+
+        if (I->tabled)
+        {
+            glTexSubImage2D(T, 0, 0, 0, I->tablew, I->tableh * n,
+                            GL_RGBA, GL_FLOAT, I->tablep);
+            I->tabled = 0;
+        }
+
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(T, L->atlas);
+        glActiveTexture(GL_TEXTURE0);
+
+        glUniform2fv(glGetUniformLocation(P->program, "page_k"), n, k[0]);
+    }
+
+    gl_uniform1i(P, "atlas",  3);
+    gl_uniform1i(P, "table",  4);
+    gl_uniform1i(P, "page_n", n);
+    gl_uniform1f(P, "page_s", PAGE_SIZE);
+    gl_uniform1f(P, "page_g", I->tableh);
+
+    glUniform4f(glGetUniformLocation(P->program, "image_r"),
+                I->r[0], I->r[1], I->r[2], I->r[3]);
+}
+
+// Find the pages of image I wanted by the current view, given its warp map F,
+// and upload any missing. The view is reduced, and each pixel records the page
+// and level that the blend will sample there.
+
+static void draw_sfeed(lightprobe *L, image *I, gl_framebuffer *F)
+{
+    const int w = (F->w + FEED_SIZE - 1) / FEED_SIZE;
+    const int h = (F->h + FEED_SIZE - 1) / FEED_SIZE;
+    const int i = (int) (I - L->images);
+
+    gl_framebuffer *B;
+    GLfloat        *p;
+    int             j;
+
+    if (init_table(L, i) && (B = gl_get_framebuffer(L->pool, w, h, 4, 32)))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, B->frame);
+        glViewport(0, 0, w, h);
+
+        glUseProgram(L->sfeed.program);
+        bind_pages(L, &L->sfeed, I);
+        gl_uniform1i(&L->sfeed, "warp",     1);
+        gl_uniform1f(&L->sfeed, "feed_k",   FEED_SIZE);
+        gl_uniform1f(&L->sfeed, "circle_r", I->values[LP_CIRCLE_RADIUS]);
+        gl_uniform2f(&L->sfeed, "circle_p", I->values[LP_CIRCLE_X],
+                                            I->values[LP_CIRCLE_Y]);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, F->color);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBlendFunc(GL_ONE, GL_ZERO);
+        gl_fill_screen();
+
+        if ((p = (GLfloat *) malloc((size_t) w * h * 4 * sizeof (GLfloat))))
+        {
+            glReadPixels(0, 0, w, h, GL_RGBA, GL_FLOAT, p);
+
+            for (j = 0; j < w * h; j++)
+                if (p[j * 4 + 3] > 0.0f)
+                    want_page(L, i, (int) p[j * 4 + 2],
+                                    (int) p[j * 4 + 0],
+                                    (int) p[j * 4 + 1]);
+            free(p);
+        }
+
+        glViewport(0, 0, F->w, F->h);
+        gl_put_framebuffer(L->pool, B);
+
+        load_pages(L, i);
+    }
+}
+
+// Find the pages of image I wanted by the image view, with K screen pixels per
+// image pixel, and upload any missing. The level follows the circle shader.
+
+static void draw_cfeed(lightprobe *L, image *I, double k, int vx, int vy,
+                                                          int ww, int wh)
+{
+    const int i = (int) (I - L->images);
+
+    if (init_table(L, i))
+    {
+        int d = (int) floor(log(max(1.0 / k, 1.0)) / log(2.0));
+        int x;
+        int y;
+
+        if (d > I->pages->n - 1)
+            d = I->pages->n - 1;
+
+        {
+            const double sx = (double) I->pages->w[d] / I->r[2] / PAGE_SIZE;
+            const double sy = (double) I->pages->h[d] / I->r[3] / PAGE_SIZE;
+
+            const int x0 = (int) floor(max(vx        / k - I->r[0], 0) * sx);
+            const int x1 = (int) floor(max((vx + ww) / k - I->r[0], 0) * sx);
+            const int y0 = (int) floor(max(vy        / k - I->r[1], 0) * sy);
+            const int y1 = (int) floor(max((vy + wh) / k - I->r[1], 0) * sy);
+
+            for     (y = y0; y <= y1; y++)
+                for (x = x0; x <= x1; x++)
+                    want_page(L, i, d, x, y);
+        }
+        load_pages(L, i);
+    }
+}
+
+// Render the given lightprobe image to the accumulation buffer with a blend
+// function of one-one. Use the image's unwrapped per-pixel quality as the alpha
+// value, and write pre-multiplied color. The result is a weighted sum of
+// images, with the total weight in the alpha channel.
+
+static void draw_sblend(lightprobe *L, image *I, int m, int n,
+                        gl_framebuffer *T)
+{
+    gl_framebuffer *F = draw_swarp(L, I, m);
+
+    // Page in what the view wants of a paged image. The moments pass of a
+    // clipped blend has already done so.
+
+    if (I->pages && n != 2)
+        draw_sfeed(L, I, F);
+
+    // Blend the image to the target buffer.
+
+    glBindFramebuffer(GL_FRAMEBUFFER, T->frame);
+
+    glUseProgram(L->sblend.program);
+    bind_pages(L, &L->sblend, I);
+    gl_uniform1i(&L->sblend, "image",  0);
+    gl_uniform1i(&L->sblend, "warp",   1);
+    gl_uniform1i(&L->sblend, "moment", 2);
+    gl_uniform1i(&L->sblend, "clip_n", n);
+    gl_uniform1f(&L->sblend, "clip_k", L->clip);
+    gl_uniform2f(&L->sblend, "image_k", I->k[0], I->k[1]);
+    gl_uniform1f(&L->sblend, "image_g", exp2(I->values[IMAGE_EXPOSURE]));
+    gl_uniform1f(&L->sblend, "circle_r", I->values[LP_CIRCLE_RADIUS]);
+    gl_uniform2f(&L->sblend, "circle_p", I->values[LP_CIRCLE_X],
+                                         I->values[LP_CIRCLE_Y]);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, F->color);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, I->texture);
+
+    glBlendFunc(GL_ONE, GL_ONE);
+    gl_fill_sphere(&L->sphere, m);
+}
+
+// Blend any/all images to the target buffer in clip pass N, zero for none.
+
+static void draw_sblends(lightprobe *L, int f, int m, int n, gl_framebuffer *T)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, T->frame);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (f & LP_RENDER_ALL)
+    {
+        int i;
+        for (i = 0; i < LP_MAX_IMAGE && !stopped(L); i++)
+            if (L->images[i].texture)
+            {
+                draw_sblend(L, L->images + i, m, n, T);
+                step(L);
+            }
+    }
+    else if (!stopped(L))
+    {
+        draw_sblend(L, L->images + L->select, m, n, T);
+        step(L);
+    }
+}
+
+// Render the accumulation buffer to the output buffer. Divide the RGB color by
+// its alpha value, normalizing the weighted sum that resulted from the
+// accumulation of images previously, and giving the final quality-blended blend
+// of inputs. If we're rendering to the screen, then apply an exposure mapping.
+
+static void draw_sfinal(lightprobe *L, int f, int m, GLfloat e, GLuint frame)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, frame);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glUseProgram(L->sfinal.program);
+    gl_uniform1i(&L->sfinal, "image",  0);
+    gl_uniform1i(&L->sfinal, "color",  1);
+    gl_uniform1f(&L->sfinal, "expo_n", e);
+    gl_uniform1f(&L->sfinal, "expo_k", (e                ) ? 1.0 : 0.0);
+    gl_uniform1f(&L->sfinal, "reso_k", (f & LP_RENDER_RES) ? 1.0 : 0.0);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, L->colormap);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, L->acc->color);
+
+    glBlendFunc(GL_ONE, GL_ZERO);
+    gl_fill_screen();
+}
+
+static void draw_sphere_grid(lightprobe *L, int m)
+{
+    glUseProgram(0);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_LINE_SMOOTH);
+
+    glColor4d(0.0, 0.0, 0.0, 0.2);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    {
+        glLineWidth(0.5f);
+        gl_fill_sphere(&L->sphere, m);
+        glLineWidth(2.0f);
+        gl_line_sphere(&L->sphere, m);
+    }
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glColor4d(1.0, 1.0, 1.0, 1.0);
+}
+
+// Return the sphere geometry mode for the projection of the given flags.
+
+static int sphere_mode(int f)
+{
+    if      (f & LP_RENDER_GLOBE) return GL_SPHERE_GLOBE;
+    else if (f & LP_RENDER_POLAR) return GL_SPHERE_POLAR;
+    else if (f & LP_RENDER_CHART) return GL_SPHERE_CHART;
+    else if (f & LP_RENDER_OCTA)  return GL_SPHERE_OCTA;
+    else                          return GL_SPHERE_GLOBE;
+}
+
+static void draw_sphere(lightprobe *L, int f, float e, GLuint frame)
+{
+    int m = sphere_mode(f);
+
+    glEnable(GL_BLEND);
+
+    // Render any/all images to the accumulation buffer. When clipping, first
+    // gather the moments of all images, which need only live for this draw.
+
+    if (f & LP_RENDER_CLIP)
+    {
+        gl_framebuffer *M = gl_get_framebuffer(L->pool, L->acc->w,
+                                                        L->acc->h, 4, 32);
+        draw_sblends(L, f, m, 1, M);
+
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, M->color);
+        glActiveTexture(GL_TEXTURE0);
+
+        draw_sblends(L, f, m, 2, L->acc);
+
+        gl_put_framebuffer(L->pool, M);
+    }
+    else draw_sblends(L, f, m, 0, L->acc);
+
+    // Map the accumulation buffer to the output buffer.
+
+    draw_sfinal(L, f, m, e, frame);
+
+    // Draw the grid.
+
+    if (f & LP_RENDER_GRID)
+        draw_sphere_grid(L, m);
+}
+
+static void draw_circle(lightprobe *L, int f, int vx, int vy,
+                                              int vw, int vh,
+                                              int ww, int wh, float e)
+{
+    image *I = L->images + L->select;
+
+    if (I->texture)
+    {
+        const double k = min((double) vw / I->w,
+                             (double) vh / I->h);
+
+        if (I->pages)
+            draw_cfeed(L, I, k, vx, vy, ww, wh);
+
+        glDisable(GL_BLEND);
+
+        glUseProgram(L->circle.program);
+        bind_pages(L, &L->circle, I);
+
+        gl_uniform1i(&L->circle, "image",  0);
+        gl_uniform1f(&L->circle, "expo_n", e);
+        gl_uniform2f(&L->circle, "image_k", I->k[0], I->k[1]);
+        gl_uniform1f(&L->circle, "circle_r", I->values[LP_CIRCLE_RADIUS]);
+        gl_uniform2f(&L->circle, "circle_p", I->values[LP_CIRCLE_X],
+                                             I->values[LP_CIRCLE_Y]);
+
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, I->texture);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        glPushMatrix();
+        {
+            glScaled(k, k, 1);
+            glBegin(GL_QUADS);
+            {
+                glVertex2i(0,    0);
+                glVertex2i(0,    I->h);
+                glVertex2i(I->w, I->h);
+                glVertex2i(I->w, 0);
+            }
+            glEnd();
+        }
+        glPopMatrix();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void draw(lightprobe *L, int f, int vx, int vy,
+                                       int vw, int vh,
+                                       int ww, int wh, float e, GLuint frame)
+{
+    glDisable(GL_DEPTH_TEST);
+//  glEnable (GL_CULL_FACE);
+
+    L->acc = resize(L, L->acc, ww, wh, 4);
+
+    L->page_time++;
+
+    L->view_still = L->view[0] == (f & (LP_RENDER_SPHERE | LP_RENDER_FACES))
+                 && L->view[1] == vx && L->view[2] == vy
+                 && L->view[3] == vw && L->view[4] == vh
+                 && L->view[5] == ww && L->view[6] == wh;
+
+    L->view[0] = f & (LP_RENDER_SPHERE | LP_RENDER_FACES);
+    L->view[1] = vx;
+    L->view[2] = vy;
+    L->view[3] = vw;
+    L->view[4] = vh;
+    L->view[5] = ww;
+    L->view[6] = wh;
+
+    transform(f, vx, vy, vw, vh, ww, wh);
+
+    if (f & LP_RENDER_SPHERE)
+        draw_sphere(L, f, e, frame);
+    else
+        draw_circle(L, f, vx, vy, vw, vh, ww, wh, e);
+}
+
+// Return the export read-back buffer, grown to at least Z bytes.
+
+static void *band(lightprobe *L, size_t z)
+{
+    void *p;
+
+    if (L->bandz < z)
+    {
+        if ((p = realloc(L->band, z)))
+        {
+            L->band  = p;
+            L->bandz = z;
+        }
+        else return 0;
+    }
+    return L->band;
+}
+
+// Read back the W-by-H RGB output of framebuffer FRAME in tiles of EXPORT_ROWS
+// rows, top row first, and deliver each to FN as part of face K of level V.
+// Framebuffer rows are bottom-up if U is nonzero, as rendered, and top-down
+// otherwise, as in a cube map texture. Each tile is flipped top-down in place.
+
+static void deliver(lightprobe *L, GLuint frame, int w, int h, int u,
+                                   int k, int v, lp_tile_fn fn, void *data)
+{
+    const size_t r = (size_t) w * 3 * sizeof (GLfloat);
+    const int    n = (h < EXPORT_ROWS) ? h : EXPORT_ROWS;
+
+    lp_tile t;
+    char   *p;
+    int     i;
+
+    if ((p = (char *) band(L, r * (n + 1))))
+    {
+        t.face   = k;
+        t.level  = v;
+        t.x      = 0;
+        t.w      = w;
+        t.width  = w;
+        t.height = h;
+        t.c      = 3;
+        t.type   = LP_TYPE_FLOAT;
+        t.stride = (int) r;
+        t.p      = p;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, frame);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+        for (t.y = 0; t.y < h && !stopped(L); t.y += n)
+        {
+            t.h = (h - t.y < n) ? h - t.y : n;
+
+            if (u)
+            {
+                glReadPixels(0, h - t.y - t.h, w, t.h, GL_RGB, GL_FLOAT, p);
+
+                for (i = 0; i < t.h / 2; i++)
+                {
+                    char *a = p + (size_t)  i            * r;
+                    char *b = p + (size_t) (t.h - i - 1) * r;
+
+                    memcpy(p + n * r, a, r);
+                    memcpy(a, b,         r);
+                    memcpy(b, p + n * r, r);
+                }
+            }
+            else
+                glReadPixels(0, t.y, w, t.h, GL_RGB, GL_FLOAT, p);
+
+            fn(&t, data);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+}
+
+// Render each side of the cube map and deliver each as it completes.
+
+static void export6(lightprobe *L, int f, int s, lp_tile_fn fn, void *data)
+{
+    gl_framebuffer *export;
+    int k;
+
+    export = gl_get_framebuffer(L->pool, s, s, 3, 32);
+    {
+        for (k = 0; k < 6 && !stopped(L); k++)
+        {
+            draw(L, f | (LP_RENDER_CUBE0 << k), 0, 0, s, s, s, s, 0,
+                                                          export->frame);
+            deliver(L, export->frame, s, s, 1, k, 0, fn, data);
+        }
+    }
+    gl_put_framebuffer(L->pool, export);
+}
+
+// Render each side of the cube map to a new S-by-S cube map texture with
+// internal format I, and generate its mipmaps. Each face is flipped into the
+// GL cube map orientation as it is copied out of the export buffer, so that
+// the texture may be sampled by direction.
+
+static GLuint draw_cube(lightprobe *L, int f, int s, GLenum i)
+{
+    const GLenum T = GL_TEXTURE_CUBE_MAP;
+
+    gl_framebuffer *export;
+    GLuint frame;
+    GLuint o;
+    int    k;
+
+    glGenTextures(1, &o);
+    glBindTexture(T,  o);
+
+    for (k = 0; k < 6; k++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, 0, i, s, s, 0,
+                     GL_RGBA, GL_FLOAT, NULL);
+
+    glTexParameteri(T, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(T, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+    glTexParameteri(T, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    glTexParameteri(T, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+
+    f = (f & ~LP_RENDER_SPHERE) | LP_RENDER_CUBE;
+
+    glGenFramebuffers(1, &frame);
+    export = gl_get_framebuffer(L->pool, s, s, 3, 32);
+    {
+        for (k = 0; k < 6; k++)
+        {
+            draw(L, f | (LP_RENDER_CUBE0 << k), 0, 0, s, s, s, s, 0,
+                                                          export->frame);
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, export->frame);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                   GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, o, 0);
+            glBlitFramebuffer(0, 0, s, s, 0, s, s, 0,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    gl_put_framebuffer(L->pool, export);
+    glDeleteFramebuffers(1, &frame);
+
+    glBindTexture(T, o);
+    glGenerateMipmap(T);
+
+    return o;
+}
+
+// Return the number of levels in a full mipmap chain with an S-by-S base.
+
+static int cube_levels(int s)
+{
+    int n = 1;
+
+    while (s >>= 1)
+        n++;
+
+    return n;
+}
+
+#define GGX_SAMPLES 64
+
+// Generate GGX importance samples for roughness R, filtering a cube map with
+// an S-by-S base. Each sample is a tangent-space half vector drawn from a
+// Hammersley sequence, plus the mip level whose texel solid angle matches the
+// solid angle of the sample, assuming the view direction equals the normal.
+
+static void ggx_samples(GLfloat h[][4], double r, int s)
+{
+    const double a  = r * r;
+    const double op = 4.0 * M_PI / (6.0 * s * s);
+
+    unsigned int i;
+    unsigned int b;
+
+    for (i = 0; i < GGX_SAMPLES; i++)
+    {
+        double u = (i + 0.5) / GGX_SAMPLES;
+        double v = 0.0;
+        double k = 0.5;
+
+        for (b = i; b; b >>= 1, k *= 0.5)
+            if (b & 1) v += k;
+
+        const double p  = 2.0 * M_PI * u;
+        const double ct = sqrt((1.0 - v) / (1.0 + (a * a - 1.0) * v));
+        const double st = sqrt(1.0 - ct * ct);
+
+        h[i][0] = (GLfloat) (st * cos(p));
+        h[i][1] = (GLfloat) (st * sin(p));
+        h[i][2] = (GLfloat) (ct);
+        h[i][3] = 0.0f;
+
+        if (a > 0.0)
+        {
+            const double d  = (ct * ct) * (a * a - 1.0) + 1.0;
+            const double D  = (a * a) / (M_PI * d * d);
+            const double os = 1.0 / (GGX_SAMPLES * D * 0.25);
+
+            h[i][3] = (GLfloat) max(0.0, 0.5 * log2(os / op) + 1.0);
+        }
+    }
+}
+
+// Convolve cube map texture C, with S-by-S base, by a GGX lobe with roughness
+// increasing linearly from zero at the base to one at the 1x1 level. Render
+// each level and face of a new cube map texture and return it.
+
+static GLuint draw_ggx(lightprobe *L, GLuint c, int s)
+{
+    const GLenum T = GL_TEXTURE_CUBE_MAP;
+    const int    n = cube_levels(s);
+
+    GLfloat h[GGX_SAMPLES][4];
+    GLuint  frame;
+    GLuint  o;
+    int     l;
+    int     k;
+
+    glGenTextures(1, &o);
+    glBindTexture(T,  o);
+
+    for     (l = 0; l < n; l++)
+        for (k = 0; k < 6; k++)
+        {
+            const int m = (s >> l) ? (s >> l) : 1;
+
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, l, GL_RGBA16F,
+                         m, m, 0, GL_RGBA, GL_FLOAT, NULL);
+        }
+
+    glTexParameteri(T, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(T, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+    glTexParameteri(T, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    glTexParameteri(T, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+    glTexParameteri(T, GL_TEXTURE_MAX_LEVEL,  n - 1);
+
+    glUseProgram(L->sggx.program);
+    gl_uniform1i(&L->sggx, "cube", 0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(T, c);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glBlendFunc(GL_ONE, GL_ZERO);
+
+    // Filter each side of each level directly into the output.
+
+    glGenFramebuffers(1, &frame);
+    glBindFramebuffer(GL_FRAMEBUFFER, frame);
+    {
+        for (l = 0; l < n; l++)
+        {
+            const int m = (s >> l) ? (s >> l) : 1;
+
+            ggx_samples(h, (n > 1) ? (double) l / (n - 1) : 0.0, s);
+
+            glUniform4fv(glGetUniformLocation(L->sggx.program, "samples"),
+                         GGX_SAMPLES, h[0]);
+            gl_uniform1f(&L->sggx, "size", (GLfloat) m);
+            glViewport(0, 0, m, m);
+
+            for (k = 0; k < 6; k++)
+            {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                       GL_TEXTURE_CUBE_MAP_POSITIVE_X + k,
+                                       o, l);
+                gl_uniform1i(&L->sggx, "face", k);
+                gl_fill_screen();
+                step(L);
+            }
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &frame);
+
+    glDisable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    return o;
+}
+
+// Deliver cube map texture C, with S-by-S base and full mipmap chain. With GGX,
+// prefilter the chain first. Deliver every level if the chain is wanted, or
+// the base alone for a plain cube map.
+
+static void deliver_cube(lightprobe *L, int f, GLuint c, int s,
+                         lp_tile_fn fn, void *data)
+{
+    const int n = (f & (LP_RENDER_GGX | LP_RENDER_KTX)) ? cube_levels(s) : 1;
+
+    GLuint  o = (f & LP_RENDER_GGX) ? draw_ggx(L, c, s) : c;
+    GLuint  frame;
+    int     l;
+    int     k;
+
+    glGenFramebuffers(1, &frame);
+
+    for     (l = 0; l < n; l++)
+        for (k = 0; k < 6; k++)
+        {
+            const int m = (s >> l) ? (s >> l) : 1;
+
+            glBindFramebuffer(GL_FRAMEBUFFER, frame);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                   GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, o, l);
+
+            deliver(L, frame, m, m, 0, k, l, fn, data);
+        }
+
+    glDeleteFramebuffers(1, &frame);
+
+    if (o != c)
+        glDeleteTextures(1, &o);
+}
+
+// Write cube map texture C, with S-by-S base and full mipmap chain, as a KTX
+// container if requested, or else as a multi-page TIFF.
+
+static void save_cube(lightprobe *L, int f, GLuint c, int s, const char *path)
+{
+    if (f & LP_RENDER_KTX)
+    {
+        GLuint o = (f & LP_RENDER_GGX) ? draw_ggx(L, c, s) : c;
+
+        if (!stopped(L))
+            gl_save_ktx(path, o, s, cube_levels(s));
+
+        if (o != c)
+            glDeleteTextures(1, &o);
+    }
+    else
+    {
+        tifsink S = { path, 0 };
+
+        deliver_cube(L, f, c, s, tiftile, &S);
+        tifclose(&S, stopped(L));
+    }
+}
+
+// Render the cube map to a texture with a generated mipmap chain, and write it
+// prefiltered or as a KTX container.
+
+static void export_cube(lightprobe *L, int f, int s, const char *path)
+{
+    GLuint cube = draw_cube(L, f, s, GL_RGBA16F);
+
+    save_cube(L, f, cube, s, path);
+
+    glDeleteTextures(1, &cube);
+}
+
+// Render the sphere and deliver the output.
+
+static void export1(lightprobe *L, int f, int w, int h,
+                    lp_tile_fn fn, void *data)
+{
+    gl_framebuffer *export;
+
+    export = gl_get_framebuffer(L->pool, w, h, 3, 32);
+    {
+        draw(L, f, 0, 0, w, h, w, h, 0, export->frame);
+        deliver(L, export->frame, w, h, 1, 0, 0, fn, data);
+    }
+    gl_put_framebuffer(L->pool, export);
+}
+
+// Render the sphere to a chart and project it onto the spherical harmonic
+// basis. The chart is never written, so the cost beyond the render is only the
+// read-back and a threaded reduction. Write 9 or 16 coefficients as text or,
+// if requested, raw binary.
+
+static void export_sh(lightprobe *L, int f, int s, const char *path)
+{
+    const int n = (f & LP_RENDER_SH16) ? 16 : 9;
+
+    gl_framebuffer *export;
+    float c[SH_MAX][3];
+    void *pixels;
+
+    // Render the sphere chart and read the output back.
+
+    export = gl_get_framebuffer(L->pool, 2 * s, s, 3, 32);
+    {
+        f = (f & ~LP_RENDER_SPHERE) | LP_RENDER_CHART;
+
+        draw(L, f, 0, 0, 2 * s, s, 2 * s, s, 0, export->frame);
+
+        if ((pixels = band(L, (size_t) 2 * s * s * 3 * sizeof (GLfloat))))
+            gl_read_framebuffer(export, 3, pixels);
+    }
+    gl_put_framebuffer(L->pool, export);
+
+    // Reduce the buffer to coefficients and write them.
+
+    if (pixels && !stopped(L))
+    {
+        sh_project((const float *) pixels, 2 * s, s, n, c);
+        sh_write(path, n, c, f & LP_RENDER_RAW);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Return the cube map size that resolves an export of the given flags and size
+// at its finest detail: a chart or octahedral map spans a right angle in half
+// the pixels of a cube face, and a polar map in a quarter. Return zero for
+// flags that export nothing.
+
+static int multi_size(int f, int s)
+{
+    if      (f & (LP_RENDER_SH9 | LP_RENDER_SH16)) return (s + 1) / 2;
+    else if (f & LP_RENDER_CHART)                  return (s + 1) / 2;
+    else if (f & LP_RENDER_POLAR)                  return (s + 3) / 4;
+    else if (f & LP_RENDER_OCTA)                   return (s + 1) / 2;
+    else if (f & LP_RENDER_CUBE)                   return s;
+    else                                           return 0;
+}
+
+// Return the level of detail at which to sample a C-by-C cube map for an
+// export of the given flags and size, so that smaller outputs are filtered.
+
+static float multi_lod(int f, int s, int c)
+{
+    return (float) max(0.0, log2((double) c / max(1, multi_size(f, s))));
+}
+
+// Resample C-by-C cube map texture CUBE to a W-by-H sphere projection or cube
+// face of the given flags, and return the output framebuffer, to be returned
+// to the pool by the caller. A face is rendered in the GL cube map orientation
+// and flipped into the export orientation, undoing the flip of draw_cube.
+
+static gl_framebuffer *draw_resample(lightprobe *L, GLuint cube, int c, int f,
+                                                               int w, int h)
+{
+    const int m = sphere_mode(f);
+
+    gl_framebuffer *export;
+    gl_framebuffer *face;
+    int k;
+
+    export = gl_get_framebuffer(L->pool, w, h, 3, 32);
+    {
+        glUseProgram(L->sresam.program);
+        gl_uniform1i(&L->sresam, "cube", 0);
+        gl_uniform1i(&L->sresam, "mode", m);
+        gl_uniform1f(&L->sresam, "lod",  multi_lod(f, h, c));
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cube);
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        glBlendFunc(GL_ONE, GL_ZERO);
+
+        if (f & LP_RENDER_FACES)
+        {
+            for (k = 0; (f & (LP_RENDER_CUBE0 << k)) == 0; k++)
+                ;
+
+            face = gl_get_framebuffer(L->pool, w, h, 3, 32);
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, face->frame);
+                glViewport(0, 0, w, h);
+
+                gl_uniform1i(&L->sresam, "face", k);
+                gl_uniform1f(&L->sresam, "size", (GLfloat) w);
+
+                gl_fill_screen();
+                step(L);
+
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, face->frame);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, export->frame);
+                glBlitFramebuffer(0, 0, w, h, 0, h, w, 0,
+                                  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            }
+            gl_put_framebuffer(L->pool, face);
+        }
+        else
+        {
+            transform(f, 0, 0, w, h, w, h);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, export->frame);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            gl_fill_sphere(&L->sphere, m);
+            step(L);
+        }
+        glDisable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    }
+    return export;
+}
+
+// Render a W-by-H page of an export of the given flags, and return its
+// framebuffer, to be returned to the pool by the caller. The page is blended
+// from the images, or resampled from C-by-C cube map texture CUBE if given.
+
+static gl_framebuffer *draw_page(lightprobe *L, GLuint cube, int c, int f,
+                                                           int w, int h)
+{
+    gl_framebuffer *export;
+
+    if (cube)
+        return draw_resample(L, cube, c, f, w, h);
+
+    export = gl_get_framebuffer(L->pool, w, h, 3, 32);
+    draw(L, f, 0, 0, w, h, w, h, 0, export->frame);
+    return export;
+}
+
+//------------------------------------------------------------------------------
+
+// Return the exposure of an LDR export: that set, or that found from a small
+// sphere chart rendered for the purpose, from the images or from C-by-C cube
+// map texture CUBE if given.
+
+static float ldr_exposure(lightprobe *L, GLuint cube, int c, int f)
+{
+    const int s = EXPOSE_SIZE;
+
+    gl_framebuffer *export;
+    void *pixels;
+    float e = 1.0f;
+
+    if (L->expo > 0.0f)
+        return L->expo;
+
+    f = (f & ~(LP_RENDER_SPHERE | LP_RENDER_FACES)) | LP_RENDER_CHART;
+
+    export = draw_page(L, cube, c, f, 2 * s, s);
+    {
+        if ((pixels = band(L, (size_t) 2 * s * s * 3 * sizeof (GLfloat))))
+        {
+            gl_read_framebuffer(export, 3, pixels);
+            e = tone_exposure((const float *) pixels, 2 * s, s);
+        }
+    }
+    gl_put_framebuffer(L->pool, export);
+
+    return e;
+}
+
+// Render a W-by-H page of an LDR export at twice that size, from the images or
+// from C-by-C cube map texture CUBE if given, read it back whole, and tone map
+// it down to 8-bit sRGB with exposure E. The page is delivered as a single
+// tile, flipped top-down.
+
+static void ldr_page(lightprobe *L, GLuint cube, int c, int f, int w, int h,
+                     int k, float e, lp_tile_fn fn, void *data)
+{
+    const size_t z = (size_t) 4 * w * h * 3 * sizeof (GLfloat);
+    const size_t r = (size_t) w * 3;
+
+    gl_framebuffer *export;
+    unsigned char  *q;
+    float          *p;
+    lp_tile         t;
+    int             i;
+
+    if ((p = (float *) band(L, z + r * (h + 1))))
+    {
+        q = (unsigned char *) p + z;
+
+        export = draw_page(L, cube, c, f, 2 * w, 2 * h);
+        {
+            gl_read_framebuffer(export, 3, p);
+        }
+        gl_put_framebuffer(L->pool, export);
+
+        if (!stopped(L))
+        {
+            tone_map(q, p, w, h, e);
+
+            for (i = 0; i < h / 2; i++)
+            {
+                memcpy(q + h * r,           q + i * r,           r);
+                memcpy(q + i * r,           q + (h - i - 1) * r, r);
+                memcpy(q + (h - i - 1) * r, q + h * r,           r);
+            }
+
+            t.face   = k;
+            t.level  = 0;
+            t.x      = 0;
+            t.y      = 0;
+            t.w      = w;
+            t.h      = h;
+            t.width  = w;
+            t.height = h;
+            t.c      = 3;
+            t.type   = LP_TYPE_UBYTE;
+            t.stride = (int) r;
+            t.p      = q;
+
+            fn(&t, data);
+        }
+    }
+}
+
+// Export a tone-mapped 8-bit preview of the chart, polar, or octahedral map,
+// or of each side of the cube map, from the images or from C-by-C cube map
+// texture CUBE if given. The cost of a thumbnail is that of a render at twice
+// its size, a small fraction of that of a full-size float export.
+
+static void export_ldr(lightprobe *L, GLuint cube, int c, int f, int s,
+                       lp_tile_fn fn, void *data)
+{
+    const float e = ldr_exposure(L, cube, c, f);
+
+    int k;
+
+    if      (f & LP_RENDER_CHART)
+        ldr_page(L, cube, c, f, 2 * s, s, 0, e, fn, data);
+    else if (f & LP_RENDER_POLAR)
+        ldr_page(L, cube, c, f,     s, s, 0, e, fn, data);
+    else if (f & LP_RENDER_OCTA)
+        ldr_page(L, cube, c, f,     s, s, 0, e, fn, data);
+    else if (f & LP_RENDER_CUBE)
+        for (k = 0; k < 6 && !stopped(L); k++)
+            ldr_page(L, cube, c, f | (LP_RENDER_CUBE0 << k),
+                     s, s, k, e, fn, data);
+}
+
+// Resample C-by-C cube map texture CUBE to a new S-by-S cube map texture, and
+// generate its mipmaps.
+
+static GLuint draw_resample_cube(lightprobe *L, GLuint cube, int c, int s)
+{
+    const GLenum T = GL_TEXTURE_CUBE_MAP;
+
+    GLuint frame;
+    GLuint o;
+    int    k;
+
+    glGenTextures(1, &o);
+    glBindTexture(T,  o);
+
+    for (k = 0; k < 6; k++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, 0, GL_RGBA32F, s, s, 0,
+                     GL_RGBA, GL_FLOAT, NULL);
+
+    glTexParameteri(T, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(T, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(T, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+    glTexParameteri(T, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    glTexParameteri(T, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+
+    glUseProgram(L->sresam.program);
+    gl_uniform1i(&L->sresam, "cube", 0);
+    gl_uniform1i(&L->sresam, "mode", GL_SPHERE_GLOBE);
+    gl_uniform1f(&L->sresam, "size", (GLfloat) s);
+    gl_uniform1f(&L->sresam, "lod",  multi_lod(LP_RENDER_CUBE, s, c));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(T, cube);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glBlendFunc(GL_ONE, GL_ZERO);
+
+    glGenFramebuffers(1, &frame);
+    glBindFramebuffer(GL_FRAMEBUFFER, frame);
+    {
+        glViewport(0, 0, s, s);
+
+        for (k = 0; k < 6; k++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                   GL_TEXTURE_CUBE_MAP_POSITIVE_X + k, o, 0);
+            gl_uniform1i(&L->sresam, "face", k);
+            gl_fill_screen();
+            step(L);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &frame);
+
+    glDisable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    glBindTexture(T, o);
+    glGenerateMipmap(T);
+
+    return o;
+}
+
+// Derive one export of the given flags and size from the C-by-C cube map
+// texture CUBE. This follows the dispatch of lp_export, with every page,
+// including the tone-mapped preview and its exposure chart, resampled from the
+// cube rather than blended again from the images.
+
+static void export_multi(lightprobe *L, GLuint cube, int c, int f, int s,
+                                                           const char *path)
+{
+    gl_framebuffer *export;
+
+    float cc[SH_MAX][3];
+    void *pixels = 0;
+    int   w = s;
+    int   h = s;
+
+    if (f & (LP_RENDER_SH9 | LP_RENDER_SH16 | LP_RENDER_CHART))
+        w = 2 * s;
+
+    if (f & (LP_RENDER_SH9 | LP_RENDER_SH16))
+    {
+        const int n = (f & LP_RENDER_SH16) ? 16 : 9;
+
+        f = (f & ~LP_RENDER_SPHERE) | LP_RENDER_CHART;
+
+        export = draw_resample(L, cube, c, f, w, h);
+
+        if ((pixels = band(L, (size_t) w * h * 3 * sizeof (GLfloat))))
+            gl_read_framebuffer(export, 3, pixels);
+
+        gl_put_framebuffer(L->pool, export);
+
+        if (pixels && !stopped(L))
+        {
+            sh_project((const float *) pixels, w, h, n, cc);
+            sh_write(path, n, cc, f & LP_RENDER_RAW);
+        }
+    }
+    else if (f & LP_RENDER_LDR)
+    {
+        tifsink S = { path, 0 };
+
+        export_ldr(L, cube, c, f, s, tiftile, &S);
+        tifclose(&S, stopped(L));
+    }
+    else if (f & (LP_RENDER_CHART | LP_RENDER_POLAR | LP_RENDER_OCTA))
+    {
+        tifsink S = { path, 0 };
+        cdfsink C;
+
+        export = draw_resample(L, cube, c, f, w, h);
+
+        if (cdfinit(&C, &S, f, path))
+        {
+            deliver(L, export->frame, w, h, 1, 0, 0, cdftile, &C);
+            cdffini(&C, stopped(L));
+        }
+        else
+            deliver(L, export->frame, w, h, 1, 0, 0, tiftile, &S);
+
+        gl_put_framebuffer(L->pool, export);
+
+        tifclose(&S, stopped(L));
+    }
+    else if (f & LP_RENDER_CUBE)
+    {
+        GLuint o = (s == c) ? cube : draw_resample_cube(L, cube, c, s);
+
+        save_cube(L, f, o, s, path);
+
+        if (o != cube)
+            glDeleteTextures(1, &o);
+    }
+}
+
+// Export N outputs of the same images at once. Blend all images once into a
+// cube map of sufficient size, and then resample that to each output. The
+// common flags F select the images, while G, S, and PATH give the projection,
+// size, and file of each output, as given to lp_export. A tone-mapped preview
+// is rendered at twice its size, and asks for a cube to match. If no output
+// exports anything, nothing is blended.
+
+void lp_export_multi(lightprobe *L, int f, int n, const int *g,
+                                                  const int *s,
+                                                  const char **path)
+{
+    GLint  m = 0;
+    GLuint cube;
+    int    c = 0;
+    int    k;
+
+    assert(L);
+
+    f = f & ~LP_RENDER_SPHERE;
+
+    for (k = 0; k < n; k++)
+        if (g[k] & LP_RENDER_LDR)
+            c = (int) max(c, multi_size(g[k], 2 * s[k]));
+        else
+            c = (int) max(c, multi_size(g[k],     s[k]));
+
+    glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &m);
+
+    if (m > 0 && c > m)
+        c = m;
+
+    if (c > 0)
+    {
+        fetch_images(L, f, 1);
+
+        cube = draw_cube(L, f, c, GL_RGBA32F);
+
+        for (k = 0; k < n && !stopped(L); k++)
+            export_multi(L, cube, c, f | g[k], s[k], path[k]);
+
+        glDeleteTextures(1, &cube);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void lp_render(lightprobe *L, int f, int vx, int vy,
+                                     int vw, int vh,
+                                     int ww, int wh, float e)
+{
+    flush(L);
+
+    fetch_images(L, (f & LP_RENDER_SPHERE) ? f : 0, 0);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    L->page_cap  = PAGE_UPLOADS;
+    L->page_wait = 0;
+
+    draw(L, f, vx, vy, vw, vh, ww, wh, e, 0);
+
+    L->page_cap  = 0;
+}
+
+// Find the extrema of log luminance over every covered texel of the last
+// render's accumulation buffer, by maximum, reducing 4x4 blocks at each pass
+// until one pixel remains. Return in V their distances from the ends of the
+// range, zero if nothing is covered.
+
+static void draw_sreduce(lightprobe *L, GLfloat *v)
+{
+    gl_framebuffer *F = L->acc;
+    gl_framebuffer *G;
+    int             m = 0;
+
+    glUseProgram(L->sreduce.program);
+    gl_uniform1i(&L->sreduce, "image",  0);
+    gl_uniform2f(&L->sreduce, "stat_r", STAT_LO, STAT_HI);
+
+    glBlendFunc(GL_ONE, GL_ZERO);
+
+    do
+    {
+        if ((G = gl_get_framebuffer(L->pool, (F->w + 3) / 4,
+                                             (F->h + 3) / 4, 4, 32)) == 0)
+            break;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, G->frame);
+        glViewport(0, 0, G->w, G->h);
+
+        gl_uniform1i(&L->sreduce, "reduce_m", m);
+        gl_uniform2f(&L->sreduce, "image_s",  F->w, F->h);
+
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, F->color);
+        gl_fill_screen();
+
+        if (F != L->acc)
+            gl_put_framebuffer(L->pool, F);
+
+        F = G;
+        m = 1;
+    }
+    while (F->w > 1 || F->h > 1);
+
+    if (F != L->acc)
+    {
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, v);
+        gl_put_framebuffer(L->pool, F);
+    }
 }
 
-static void view_globe(int vx, int vy, int vw, int vh, int ww, int wh)
+// Gather the luminance statistics of the last sphere render from its
+// accumulation buffer, without reading the buffer back. A grid of samples is
+// scattered as points to a row of the histogram bins followed by a pixel
+// blended additively to the sum and count of log luminance, and the extrema
+// are reduced from every texel. Only a row and a pixel return to the CPU, so
+// this is cheap enough to run with every render. Return the number of covered
+// samples, zero if the last render was not of the sphere.
+
+int lp_get_luminance_stats(lightprobe *L, lp_luminance_stats *S)
 {
-    double x = (double) vx / max(1, vw - ww);
-    double y = (double) vy / max(1, vh - wh);
+    const int n = LP_LUMINANCE_BINS;
 
-    glRotated(180 * y -  90, 1, 0, 0);
-    glRotated(360 * x - 180, 0, 1, 0);
-}
+    gl_framebuffer *F;
+    GLfloat         h[LP_LUMINANCE_BINS];
+    GLfloat         v[4];
+    GLfloat         e[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    int             i;
 
-static void view_chart(int vx, int vy, int vw, int vh, int ww, int wh)
-{
-    double k = min(0.5 * vw, vh);
+    assert(L);
+    assert(S);
 
-    glScaled(2 * k, k, 1);
-}
+    memset(S, 0, sizeof (lp_luminance_stats));
 
-static void view_polar(int vx, int vy, int vw, int vh, int ww, int wh)
-{
-    double x = 0.5 * vw;
-    double y = 0.5 * vh;
-    double k = min(x, y);
+    S->lo = STAT_LO;
+    S->hi = STAT_HI;
 
-    glTranslated(x, y, 0);
-    glScaled    (k, k, 1);
-}
+    if (L->acc == 0 || (L->view[0] & LP_RENDER_SPHERE) == 0)
+        return 0;
 
-static void view_cube(int i)
-{
-    switch (i)
+    if ((F = gl_get_framebuffer(L->pool, n + 1, 1, 4, 32)))
     {
-    case 0: glRotated(+90, 0, 1, 0);                          break;
-    case 1: glRotated(-90, 0, 1, 0);                          break;
-    case 2: glRotated(-90, 1, 0, 0); glRotated(180, 0, 1, 0); break;
-    case 3: glRotated(+90, 1, 0, 0); glRotated(180, 0, 1, 0); break;
-    case 4: glRotated(180, 0, 1, 0);                          break;
-    }
-}
+        glBindFramebuffer(GL_FRAMEBUFFER, F->frame);
+        glViewport(0, 0, n + 1, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
 
-static void transform(int f, int vx, int vy, int vw, int vh, int ww, int wh)
-{
-    glViewport(0, 0, ww, wh);
+        glUseProgram(L->sstat.program);
+        gl_uniform1i(&L->sstat, "image",  0);
+        gl_uniform2f(&L->sstat, "image_s", L->acc->w, L->acc->h);
+        gl_uniform1f(&L->sstat, "stat_n", n);
+        gl_uniform2f(&L->sstat, "stat_r", STAT_LO, STAT_HI);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, L->acc->color);
 
-    if      (f & LP_RENDER_GLOBE) proj_globe(vx, vy, vw, vh, ww, wh);
-    else if (f & LP_RENDER_CHART) proj_chart(vx, vy, vw, vh, ww, wh);
-    else if (f & LP_RENDER_POLAR) proj_polar(vx, vy, vw, vh, ww, wh);
-    else if (f & LP_RENDER_CUBE0) proj_cube();
-    else if (f & LP_RENDER_CUBE1) proj_cube();
-    else if (f & LP_RENDER_CUBE2) proj_cube();
-    else if (f & LP_RENDER_CUBE3) proj_cube();
-    else if (f & LP_RENDER_CUBE4) proj_cube();
-    else if (f & LP_RENDER_CUBE5) proj_cube();
-    else                          proj_image(vx, vy, vw, vh, ww, wh);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+        glBindBuffer(GL_ARRAY_BUFFER, L->stat_buf);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        {
+            glVertexPointer(2, GL_FLOAT, 0, 0);
 
-    if      (f & LP_RENDER_GLOBE) view_globe(vx, vy, vw, vh, ww, wh);
-    else if (f & LP_RENDER_CHART) view_chart(vx, vy, vw, vh, ww, wh);
-    else if (f & LP_RENDER_POLAR) view_polar(vx, vy, vw, vh, ww, wh);
-    else if (f & LP_RENDER_CUBE0) view_cube(0);
-    else if (f & LP_RENDER_CUBE1) view_cube(1);
-    else if (f & LP_RENDER_CUBE2) view_cube(2);
-    else if (f & LP_RENDER_CUBE3) view_cube(3);
-    else if (f & LP_RENDER_CUBE4) view_cube(4);
-    else if (f & LP_RENDER_CUBE5) view_cube(5);
-}
+            for (i = 0; i < 2; i++)
+            {
+                gl_uniform1i(&L->sstat, "stat_m", i);
+                glDrawArrays(GL_POINTS, 0, STAT_GRID * STAT_GRID);
+            }
+        }
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-//------------------------------------------------------------------------------
+        glReadPixels(0, 0, n, 1, GL_RED,  GL_FLOAT, h);
+        glReadPixels(n, 0, 1, 1, GL_RGBA, GL_FLOAT, v);
 
-// Render the given lightprobe image to the accumulation buffer with a blend
-// function of one-one. Use the image's unwrapped per-pixel quality as the alpha
-// value, and write pre-multiplied color. The result is a weighted sum of
-// images, with the total weight in the alpha channel.
+        gl_put_framebuffer(L->pool, F);
 
-static void draw_sblend(lightprobe *L, image *I, int m)
-{
-    GLuint P;
+        draw_sreduce(L, e);
 
-    // Set up the sphere transform for this image.
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, L->acc->w, L->acc->h);
 
-    glMatrixMode(GL_TEXTURE);
-    {
-        glLoadIdentity();
-        glRotatef(I->values[LP_SPHERE_ROLL],       0.0f, 0.0f, 1.0f);
-        glRotatef(I->values[LP_SPHERE_ELEVATION], -1.0f, 0.0f, 0.0f);
-        glRotatef(I->values[LP_SPHERE_AZIMUTH],    0.0f, 1.0f, 0.0f);
+        // The extrema are offset from the ends of the range, as the
+        // reduction gives zero where nothing is covered.
+
+        if ((S->count = (int) (v[1] + 0.5f)) > 0)
+        {
+            S->mean     = v[0] / v[1];
+            S->max      = STAT_LO + e[0];
+            S->min      = STAT_HI - e[1];
+            S->exposure = tone_key(exp2(S->mean));
+
+            for (i = 0; i < n; i++)
+                S->bins[i] = (int) (h[i] + 0.5f);
+        }
     }
-    glMatrixMode(GL_MODELVIEW);
+    return S->count;
+}
 
-    // Render texture coordinates to the temporary buffer.
+// Match the exposures of all images where they overlap. Each is blended alone
+// to a small sphere chart, and the differences of their log luminance are fit
+// by gain_solve, whose solution replaces the exposure value of each image.
+// Warps of the chart are cached as for any view, and page uploads are capped
+// as for an interactive render, so this is cheap enough to run whenever the
+// alignment changes. The charts render to a pooled buffer, and the view and
+// accumulation buffer of the last render are left as they were. Return the
+// number of samples of overlap found.
 
-    glBindFramebuffer(GL_FRAMEBUFFER, L->tmp.frame);
+int lp_solve_exposure(lightprobe *L)
+{
+    const int    w = 2 * SOLVE_SIZE;
+    const int    h =     SOLVE_SIZE;
+    const size_t z = (size_t) w * h * 4;
+
+    gl_framebuffer *F;
+    const float    *p[LP_MAX_IMAGE];
+    float           e[LP_MAX_IMAGE];
+    float           g[LP_MAX_IMAGE];
+    int             d[LP_MAX_IMAGE];
+    int             v[7];
+    float          *b;
+    int             n = 0;
+    int             m = 0;
+    int             i;
 
-    if      (m == GL_SPHERE_CHART) P = L->schart.program;
-    else if (m == GL_SPHERE_POLAR) P = L->spolar.program;
-    else                           P = L->sglobe.program;
+    assert(L);
 
-    glUseProgram(P);
-    GLUNIFORM1F(P, "circle_r", I->values[LP_CIRCLE_RADIUS]);
-    GLUNIFORM2F(P, "circle_p", I->values[LP_CIRCLE_X],
-                               I->values[LP_CIRCLE_Y]);
+    for (i = 0; i < LP_MAX_IMAGE; i++)
+        if (L->images[i].texture)
+            d[n++] = i;
 
-    glClear(GL_COLOR_BUFFER_BIT);
-    glBlendFunc(GL_ONE, GL_ZERO);
-    gl_fill_sphere(&L->sphere, m);
+    if (n > 1 && (b = (float *) band(L, n * z * sizeof (GLfloat)))
+              && (F = gl_get_framebuffer(L->pool, w, h, 4, 32)))
+    {
+        glDisable(GL_DEPTH_TEST);
 
-    // Blend the image to the accumulation buffer.
+        memcpy(v, L->view, sizeof (v));
 
-    glBindFramebuffer(GL_FRAMEBUFFER, L->acc.frame);
+        L->page_time++;
+        L->page_cap = PAGE_UPLOADS;
 
-    glUseProgram(L->sblend.program);
-    gl_uniform1i(&L->sblend, "image", 0);
-    gl_uniform1i(&L->sblend, "coord", 1);
+        L->view[0] = LP_RENDER_CHART;
+        L->view[1] = 0;
+        L->view[2] = 0;
+        L->view[3] = w;
+        L->view[4] = h;
+        L->view[5] = w;
+        L->view[6] = h;
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, L->tmp.color);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, I->texture);
+        transform(LP_RENDER_CHART, 0, 0, w, h, w, h);
 
-    glBlendFunc(GL_ONE, GL_ONE);
-    gl_fill_sphere(&L->sphere, m);
-}
+        glEnable(GL_BLEND);
 
-// Render the accumulation buffer to the output buffer. Divide the RGB color by
-// its alpha value, normalizing the weighted sum that resulted from the
-// accumulation of images previously, and giving the final quality-blended blend
-// of inputs. If we're rendering to the screen, then apply an exposure mapping.
+        for (i = 0; i < n; i++)
+        {
+            image *I = L->images + d[i];
 
-static void draw_sfinal(lightprobe *L, int f, int m, GLfloat e, GLuint frame)
-{
-    glBindFramebuffer(GL_FRAMEBUFFER, frame);
-    glClear(GL_COLOR_BUFFER_BIT);
+            glBindFramebuffer(GL_FRAMEBUFFER, F->frame);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(L->sfinal.program);
-    gl_uniform1i(&L->sfinal, "image",  0);
-    gl_uniform1i(&L->sfinal, "color",  1);
-    gl_uniform1f(&L->sfinal, "expo_n", e);
-    gl_uniform1f(&L->sfinal, "expo_k", (e                ) ? 1.0 : 0.0);
-    gl_uniform1f(&L->sfinal, "reso_k", (f & LP_RENDER_RES) ? 1.0 : 0.0);
+            draw_sblend(L, I, GL_SPHERE_CHART, 0, F);
+            gl_read_framebuffer(F, 4, b + i * z);
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_1D, L->colormap);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, L->acc.color);
+            p[i] = b + i * z;
+            e[i] = I->values[IMAGE_EXPOSURE];
+        }
 
-    glBlendFunc(GL_ONE, GL_ZERO);
-    gl_fill_screen();
-}
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        gl_put_framebuffer(L->pool, F);
 
-static void draw_sphere_grid(lightprobe *L, int m)
-{
-    glUseProgram(0);
+        memcpy(L->view, v, sizeof (v));
 
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_LINE_SMOOTH);
+        L->page_cap = 0;
 
-    glColor4d(0.0, 0.0, 0.0, 0.2);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    {
-        glLineWidth(0.5f);
-        gl_fill_sphere(&L->sphere, m);
-        glLineWidth(2.0f);
-        gl_line_sphere(&L->sphere, m);
+        if ((m = gain_solve(p, n, w, h, e, g)))
+            for (i = 0; i < n; i++)
+                L->images[d[i]].values[IMAGE_EXPOSURE] = g[i];
     }
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glColor4d(1.0, 1.0, 1.0, 1.0);
+    return m;
 }
 
-static void draw_sphere(lightprobe *L, int f, float e, GLuint frame)
-{
-    int m = 0;
+// Render an export of the given flags and size, delivering its pixels to FN
+// tile by tile.
 
-    if      (f & LP_RENDER_GLOBE) m = GL_SPHERE_GLOBE;
-    else if (f & LP_RENDER_POLAR) m = GL_SPHERE_POLAR;
-    else if (f & LP_RENDER_CHART) m = GL_SPHERE_CHART;
+static void export_data(lightprobe *L, int f, int s, lp_tile_fn fn, void *data)
+{
+    if      (f & LP_RENDER_LDR)   export_ldr(L, 0, 0, f, s, fn, data);
+    else if (f & LP_RENDER_CHART) export1(L, f, 2 * s, s, fn, data);
+    else if (f & LP_RENDER_POLAR) export1(L, f,     s, s, fn, data);
+    else if (f & LP_RENDER_OCTA)  export1(L, f,     s, s, fn, data);
+    else if (f & (LP_RENDER_GGX | LP_RENDER_KTX))
+    {
+        GLuint cube = draw_cube(L, f, s, GL_RGBA16F);
 
-    glEnable(GL_BLEND);
+        deliver_cube(L, f, cube, s, fn, data);
 
-    // Initialize the accumulation buffer.
+        glDeleteTextures(1, &cube);
+    }
+    else if (f & LP_RENDER_CUBE)  export6(L, f, s, fn, data);
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, L->acc.frame);
-    glClear(GL_COLOR_BUFFER_BIT);
+// Exports wait for every image they use to reach full resolution, except
+// within the worker, whose snapshot was brought there when it was queued.
 
-    // Render any/all images to the accumulation buffer.
+void lp_export(lightprobe *L, int f, int s, const char *path)
+{
+    if (L->job == 0)
+        fetch_images(L, f, 1);
 
-    if (f & LP_RENDER_ALL)
+    if      (f & (LP_RENDER_SH9 | LP_RENDER_SH16))
+        export_sh  (L, f, s, path);
+    else if (f & LP_RENDER_KTX)
+        export_cube(L, f, s, path);
+    else
     {
-        int i;
-        for (i = 0; i < LP_MAX_IMAGE; i++)
-            if (L->images[i].texture)
-                draw_sblend(L, L->images + i, m);
+        tifsink S = { path, 0 };
+        cdfsink C;
+
+        if (cdfinit(&C, &S, f, path))
+        {
+            export_data(L, f, s, cdftile, &C);
+            cdffini(&C, stopped(L));
+        }
+        else
+            export_data(L, f, s, tiftile, &S);
+
+        tifclose(&S, stopped(L));
     }
-    else draw_sblend(L, L->images + L->select, m);
+}
 
-    // Map the accumulation buffer to the output buffer.
+// Export to memory. Deliver the pixels of an export of the given flags and
+// size to FN, with DATA, in tiles of whole rows as each face or level is read
+// back. Tiles are top-down, and each face is delivered in order from its first
+// row to its last. A tile's buffer is reused once FN returns, so that memory
+// stays bounded regardless of size. Spherical harmonic exports give no pixels.
 
-    draw_sfinal(L, f, m, e, frame);
+void lp_export_data(lightprobe *L, int f, int s, lp_tile_fn fn, void *data)
+{
+    assert(L);
+    assert(fn);
 
-    // Draw the grid.
+    fetch_images(L, f, 1);
 
-    if (f & LP_RENDER_GRID)
-        draw_sphere_grid(L, m);
+    if ((f & (LP_RENDER_SH9 | LP_RENDER_SH16)) == 0)
+        export_data(L, f, s, fn, data);
 }
 
-static void draw_circle(lightprobe *L, int f, int vw, int vh, float e)
+// Approximate the sphere by up to 2^K directional lights, by median cut of a
+// 2S-by-S sphere chart rendered with the given flags. Each light gives its
+// direction, its color as radiance integrated over its region, and the solid
+// angle of that region. Return the number of lights written.
+
+int lp_get_lights(lightprobe *L, int f, int k, int s, lp_light *lights)
 {
-    const image *I = L->images + L->select;
+    gl_framebuffer *export;
+    void *pixels;
+    int   n = 0;
 
-    if (I->texture)
-    {
-        const double k = min((double) vw / I->w,
-                             (double) vh / I->h);
+    assert(L);
+    assert(lights);
+    assert(k >= 0);
 
-        glDisable(GL_BLEND);
+    fetch_images(L, f, 1);
 
-        glUseProgram(L->circle.program);
+    export = gl_get_framebuffer(L->pool, 2 * s, s, 3, 32);
+    {
+        f = (f & ~(LP_RENDER_SPHERE | LP_RENDER_FACES)) | LP_RENDER_CHART;
 
-        gl_uniform1i(&L->circle, "image",  0);
-        gl_uniform1f(&L->circle, "expo_n", e);
-        gl_uniform1f(&L->circle, "circle_r", I->values[LP_CIRCLE_RADIUS]);
-        gl_uniform2f(&L->circle, "circle_p", I->values[LP_CIRCLE_X],
-                                             I->values[LP_CIRCLE_Y]);
+        draw(L, f, 0, 0, 2 * s, s, 2 * s, s, 0, export->frame);
 
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, I->texture);
+        if ((pixels = band(L, (size_t) 2 * s * s * 3 * sizeof (GLfloat))))
+            gl_read_framebuffer(export, 3, pixels);
+    }
+    gl_put_framebuffer(L->pool, export);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT);
+    if (pixels)
+        n = light_cut((const float *) pixels, 2 * s, s, k, lights);
 
-        glPushMatrix();
-        {
-            glScaled(k, k, 1);
-            glBegin(GL_QUADS);
-            {
-                glVertex2i(0,    0);
-                glVertex2i(0,    I->h);
-                glVertex2i(I->w, I->h);
-                glVertex2i(I->w, 0);
-            }
-            glEnd();
-        }
-        glPopMatrix();
-    }
+    return n;
 }
 
 //------------------------------------------------------------------------------
 
-static void draw(lightprobe *L, int f, int vx, int vy,
-                                       int vw, int vh,
-                                       int ww, int wh, float e, GLuint frame)
+// Return the number of rendering passes needed to export the given flags, for
+// the measure of a job's progress. This follows the dispatch of lp_export.
+
+static int export_steps(lightprobe *L, int f, int s)
 {
-    glDisable(GL_DEPTH_TEST);
-//  glEnable (GL_CULL_FACE);
+    int n = 1;
+    int i;
 
-    gl_size_framebuffer(&L->tmp, ww, wh, 2);
-    gl_size_framebuffer(&L->acc, ww, wh, 4);
+    if (f & LP_RENDER_ALL)
+        for (n = 0, i = 0; i < LP_MAX_IMAGE; i++)
+            if (L->images[i].texture)
+                n++;
 
-    transform(f, vx, vy, vw, vh, ww, wh);
+    if (f & LP_RENDER_CLIP)
+        n *= 2;
 
-    if (f & 0xF)
-        draw_sphere(L, f, e, frame);
-    else
-        draw_circle(L, f, vw, vh, e);
+    if ((f & LP_RENDER_LDR) && L->expo == 0.0f)
+    {
+        if (f & (LP_RENDER_CHART | LP_RENDER_POLAR | LP_RENDER_OCTA))
+                                                   return 2 * n;
+        else                                       return 7 * n;
+    }
+
+    if      (f & (LP_RENDER_SH9 | LP_RENDER_SH16)) return n;
+    else if (f & (LP_RENDER_CHART | LP_RENDER_POLAR | LP_RENDER_OCTA))
+                                                   return n;
+    else if (f & LP_RENDER_GGX)                    return 6 * n
+                                                        + 6 * cube_levels(s);
+    else                                           return 6 * n;
 }
 
-static void export6(lightprobe *L, int f, int s, const char *path)
+// Queue an export to the background worker, starting it if necessary, and
+// return a job handle. The export sees the images as they are now, and later
+// edits do not affect it. If given, FN is called on the worker thread when
+// the job ends. Return null if a worker context cannot be created, in which
+// case the caller may export in the foreground instead.
+
+lp_job *lp_export_async(lightprobe *L, int f, int s, const char *path,
+                        lp_job_fn fn, void *data)
 {
-    gl_framebuffer export;
-    void *pixels[6];
+    lp_job *J = 0;
+    int     i;
+
+    assert(L);
+    assert(path);
 
-    // Render each side of the cube map and copy each output to a buffer.
+    if (L->worker == 0)
+        L->worker = init_worker();
 
-    gl_init_framebuffer(&export, s, s, 3);
+    if (L->worker && (J = (lp_job *) calloc(1, sizeof (lp_job))))
     {
-        draw(L, f | LP_RENDER_CUBE0, 0, 0, s, s, s, s, 0, export.frame);
-        pixels[0] = gl_copy_framebuffer(&export, 3);
+        if ((J->path = (char *) malloc(strlen(path) + 1)))
+        {
+            strcpy(J->path, path);
+
+            fetch_images(L, f, 1);
 
-        draw(L, f | LP_RENDER_CUBE1, 0, 0, s, s, s, s, 0, export.frame);
-        pixels[1] = gl_copy_framebuffer(&export, 3);
+            memcpy(J->images, L->images, sizeof (J->images));
 
-        draw(L, f | LP_RENDER_CUBE2, 0, 0, s, s, s, s, 0, export.frame);
-        pixels[2] = gl_copy_framebuffer(&export, 3);
+            for (i = 0; i < LP_MAX_IMAGE; i++)
+            {
+                memset(J->images[i].warps, 0, sizeof (J->images[i].warps));
+
+                J->images[i].path    = 0;
+                J->images[i].preview = 0;
+                J->images[i].stream  = 0;
+                J->images[i].table   = 0;
+                J->images[i].tablep  = 0;
+                J->images[i].tablew  = 0;
+                J->images[i].tableh  = 0;
+                J->images[i].tabled  = 0;
+            }
+
+            J->refs   = 2;
+            J->status = LP_JOB_QUEUED;
+            J->steps  = export_steps(L, f, s);
+            J->select = L->select;
+            J->clip   = L->clip;
+            J->expo   = L->expo;
+            J->f      = f;
+            J->s      = s;
+            J->fn     = fn;
+            J->data   = data;
+
+            // Ensure all image uploads are complete before the worker reads.
+
+            glFinish();
+
+            pthread_mutex_lock(&job_mutex);
+            {
+                for (i = 0; i < LP_MAX_IMAGE; i++)
+                    if (J->images[i].pages)
+                        J->images[i].pages->refs++;
+
+                if (L->worker->tail)
+                    L->worker->tail->next = J;
+                else
+                    L->worker->head       = J;
 
-        draw(L, f | LP_RENDER_CUBE3, 0, 0, s, s, s, s, 0, export.frame);
-        pixels[3] = gl_copy_framebuffer(&export, 3);
+                L->worker->tail = J;
+                L->worker->busy++;
 
-        draw(L, f | LP_RENDER_CUBE4, 0, 0, s, s, s, s, 0, export.frame);
-        pixels[4] = gl_copy_framebuffer(&export, 3);
+                pthread_cond_broadcast(&job_cond);
+            }
+            pthread_mutex_unlock(&job_mutex);
 
-        draw(L, f | LP_RENDER_CUBE5, 0, 0, s, s, s, s, 0, export.frame);
-        pixels[5] = gl_copy_framebuffer(&export, 3);
+            return J;
+        }
+        free(J);
     }
-    gl_free_framebuffer(&export);
+    return 0;
+}
+
+int lp_job_status(lp_job *J)
+{
+    int s;
 
-    // Write the buffers to a file and release them.
+    assert(J);
 
-    tifwriten(path, s, s, 3, 6, pixels);
+    pthread_mutex_lock(&job_mutex);
+    s = J->status;
+    pthread_mutex_unlock(&job_mutex);
 
-    free(pixels[5]);
-    free(pixels[4]);
-    free(pixels[3]);
-    free(pixels[2]);
-    free(pixels[1]);
-    free(pixels[0]);
+    return s;
 }
 
-static void export1(lightprobe *L, int f, int w, int h, const char *path)
+// Return the fraction of a job's rendering passes completed.
+
+float lp_job_progress(lp_job *J)
 {
-    gl_framebuffer export;
-    void *pixels;
+    float p = 0.0f;
 
-    // Render the sphere and copy the output to a buffer.
+    assert(J);
 
-    gl_init_framebuffer(&export, w, h, 3);
+    pthread_mutex_lock(&job_mutex);
     {
-        draw(L, f, 0, 0, w, h, w, h, 0, export.frame);
-        pixels = gl_copy_framebuffer(&export, 3);
+        if      (J->status == LP_JOB_DONE) p = 1.0f;
+        else if (J->steps  > 0)            p = (float) J->step / J->steps;
     }
-    gl_free_framebuffer(&export);
+    pthread_mutex_unlock(&job_mutex);
+
+    return (p < 1.0f) ? p : 1.0f;
+}
 
-    // Write the buffer to a file and release it.
+// Request that a job stop. A queued job is skipped, and a running job stops
+// after its current pass without writing its output.
 
-    tifwrite(path, w, h, 3, pixels);
+void lp_job_cancel(lp_job *J)
+{
+    assert(J);
 
-    free(pixels);
+    pthread_mutex_lock(&job_mutex);
+    J->cancel = 1;
+    pthread_mutex_unlock(&job_mutex);
 }
 
-//------------------------------------------------------------------------------
+// Block until a job ends, and return its final status.
 
-void lp_render(lightprobe *L, int f, int vx, int vy,
-                                     int vw, int vh,
-                                     int ww, int wh, float e)
+int lp_job_wait(lp_job *J)
 {
-    glClear(GL_COLOR_BUFFER_BIT);
+    int s;
 
-    draw(L, f, vx, vy, vw, vh, ww, wh, e, 0);
+    assert(J);
+
+    pthread_mutex_lock(&job_mutex);
+    {
+        while (J->status == LP_JOB_QUEUED || J->status == LP_JOB_RUNNING)
+            pthread_cond_wait(&job_cond, &job_mutex);
+
+        s = J->status;
+    }
+    pthread_mutex_unlock(&job_mutex);
+
+    return s;
 }
 
-void lp_export(lightprobe *L, int f, int s, const char *path)
+// Release the caller's handle on a job. A job that has not ended runs on,
+// unless cancelled, and is freed by the worker when it does.
+
+void lp_job_free(lp_job *J)
 {
-    if      (f & LP_RENDER_CHART) export1(L, f, 2 * s, s, path);
-    else if (f & LP_RENDER_POLAR) export1(L, f,     s, s, path);
-    else if (f & LP_RENDER_CUBE)  export6(L, f,        s, path);
+    assert(J);
+
+    pthread_mutex_lock(&job_mutex);
+    release(J);
+    pthread_mutex_unlock(&job_mutex);
 }
 
 //------------------------------------------------------------------------------
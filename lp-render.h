@@ -26,11 +26,45 @@ void        lp_free(lightprobe *lp);
 /*----------------------------------------------------------------------------*/
 
 int  lp_add_image(lightprobe *lp, const char *path);
+int  lp_add_bracket(lightprobe *lp, const char **path, const float *t, int n);
 void lp_del_image(lightprobe *lp, int);
 void lp_sel_image(lightprobe *lp, int);
 
 /*----------------------------------------------------------------------------*/
 
+enum
+{
+    LP_TYPE_UBYTE,
+    LP_TYPE_BYTE,
+    LP_TYPE_USHORT,
+    LP_TYPE_SHORT,
+    LP_TYPE_HALF,
+    LP_TYPE_UINT,
+    LP_TYPE_INT,
+    LP_TYPE_FLOAT
+};
+
+typedef void (*lp_release_fn)(void *data);
+
+int   lp_add_image_data  (lightprobe *lp, const void *p, int w, int h, int c,
+                          int type, int stride, lp_release_fn fn, void *data);
+int   lp_swap_image_data (lightprobe *lp, int i, const void *p, int w, int h,
+                          int c, int type, int stride, lp_release_fn fn,
+                                                       void *data);
+void *lp_map_image_data  (lightprobe *lp, int w, int h, int c, int type);
+int   lp_add_image_mapped(lightprobe *lp);
+void *lp_read_image      (const char *path, int *w, int *h, int *c, int *type);
+
+void lp_set_response(lightprobe *lp, const float *g, int n);
+
+int         lp_save_project(lightprobe *lp, const char *path);
+int         lp_load_project(lightprobe *lp, const char *path);
+const char *lp_get_path    (lightprobe *lp, int);
+int         lp_get_pending (lightprobe *lp);
+int         lp_get_images  (lightprobe *lp);
+
+/*----------------------------------------------------------------------------*/
+
 enum
 {
     LP_CIRCLE_X,
@@ -50,6 +84,16 @@ int   lp_get_width (lightprobe *lp);
 int   lp_get_height(lightprobe *lp);
 float lp_get_value (lightprobe *lp, int k);
 void  lp_set_value (lightprobe *lp, int k, float v);
+float lp_get_gain  (lightprobe *lp);
+void  lp_set_gain  (lightprobe *lp, float g);
+void  lp_set_clip  (lightprobe *lp, float k);
+void  lp_set_crop  (lightprobe *lp, float m);
+void  lp_set_exposure(lightprobe *lp, float e);
+void  lp_set_cache (lightprobe *lp, int m, int b);
+void  lp_set_pool  (lightprobe *lp, int m);
+void  lp_set_pages (lightprobe *lp, int m);
+void  lp_get_pool  (lightprobe *lp, int *hits, int *misses, int *m);
+int   lp_solve_exposure(lightprobe *lp);
 
 /*----------------------------------------------------------------------------*/
 
@@ -62,21 +106,153 @@ enum
     LP_RENDER_ALL   =    16,
     LP_RENDER_RES   =    32,
     LP_RENDER_GRID  =    64,
+    LP_RENDER_OCTA  =   128,
     LP_RENDER_CUBE0  =  256,
     LP_RENDER_CUBE1  =  512,
     LP_RENDER_CUBE2  = 1024,
     LP_RENDER_CUBE3  = 2048,
     LP_RENDER_CUBE4  = 4096,
     LP_RENDER_CUBE5  = 8192,
+    LP_RENDER_SH9    = 16384,
+    LP_RENDER_SH16   = 32768,
+    LP_RENDER_RAW    = 65536,
+    LP_RENDER_GGX    = 131072,
+    LP_RENDER_KTX    = 262144,
+    LP_RENDER_CLIP   = 524288,
+    LP_RENDER_LDR    = 1048576,
+    LP_RENDER_CDF    = 2097152,
 };
 
 void lp_export(lightprobe *lp, int f, int s, const char *path);
+void lp_export_multi(lightprobe *lp, int f, int n, const int *g,
+                                                   const int *s,
+                                                   const char **path);
 void lp_render(lightprobe *lp, int f, int vx, int vy,
                                       int vw, int vh,
                                       int ww, int wh, float e);
 
 /*----------------------------------------------------------------------------*/
 
+enum
+{
+    LP_LUMINANCE_BINS = 64
+};
+
+struct lp_luminance_stats
+{
+    float min;
+    float max;
+    float mean;
+    float exposure;
+    float lo;
+    float hi;
+    int   count;
+    int   bins[LP_LUMINANCE_BINS];
+};
+
+typedef struct lp_luminance_stats lp_luminance_stats;
+
+/* The histogram, mean, and count are of a 128x128 grid of samples of the     */
+/* last sphere render, so a highlight smaller than the grid spacing may go    */
+/* unbinned. The min and max are exact, reduced from every pixel.             */
+
+int lp_get_luminance_stats(lightprobe *lp, lp_luminance_stats *stats);
+
+/*----------------------------------------------------------------------------*/
+
+struct lp_light
+{
+    float d[3];
+    float c[3];
+    float a;
+};
+
+typedef struct lp_light lp_light;
+
+int lp_get_lights(lightprobe *lp, int f, int k, int s, lp_light *lights);
+
+/*----------------------------------------------------------------------------*/
+
+struct lp_tile
+{
+    int         face;
+    int         level;
+    int         x;
+    int         y;
+    int         w;
+    int         h;
+    int         width;
+    int         height;
+    int         c;
+    int         type;
+    int         stride;
+    const void *p;
+};
+
+typedef struct lp_tile lp_tile;
+
+typedef void (*lp_tile_fn)(const lp_tile *tile, void *data);
+
+void lp_export_data(lightprobe *lp, int f, int s, lp_tile_fn fn, void *data);
+
+typedef struct lp_tiff lp_tiff;
+
+lp_tiff *lp_tiff_open (const char *path);
+void     lp_tiff_write(const lp_tile *tile, void *tiff);
+int      lp_tiff_close(lp_tiff *tiff);
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct lp_job lp_job;
+
+typedef void (*lp_job_fn)(lp_job *job, void *data);
+
+enum
+{
+    LP_JOB_QUEUED,
+    LP_JOB_RUNNING,
+    LP_JOB_DONE,
+    LP_JOB_CANCELLED
+};
+
+lp_job *lp_export_async(lightprobe *lp, int f, int s, const char *path,
+                        lp_job_fn fn, void *data);
+
+int     lp_job_status  (lp_job *job);
+float   lp_job_progress(lp_job *job);
+void    lp_job_cancel  (lp_job *job);
+int     lp_job_wait    (lp_job *job);
+void    lp_job_free    (lp_job *job);
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct lp_batch lp_batch;
+
+struct lp_batch_stats
+{
+    int    done;
+    int    failed;
+    double seconds;
+    double steady;
+    double decode;
+    double render;
+    double encode;
+    double pixels;
+};
+
+typedef struct lp_batch_stats lp_batch_stats;
+
+lp_batch *lp_batch_init(int n, int m);
+int       lp_batch_add (lp_batch *batch, const char *project,
+                        int f, int s, const char *path);
+int       lp_batch_sequence(lp_batch *batch, const char *project,
+                            int first, int last,
+                            int f, int s, const char *path);
+void      lp_batch_wait(lp_batch *batch, lp_batch_stats *stats);
+void      lp_batch_free(lp_batch *batch);
+
+/*----------------------------------------------------------------------------*/
+
 unsigned int lp_load_texture(const char *path, int *w, int *h);
 unsigned int lp_load_cubemap(const char *path);
 
@@ -1,35 +1,101 @@
 #extension GL_ARB_texture_rectangle : enable
 
 uniform sampler2DRect image;
-uniform sampler2DRect coord;
+uniform sampler2DRect warp;
+uniform sampler2DRect moment;
+uniform sampler2DRect atlas;
+uniform sampler2DRect table;
+
+uniform vec4  image_r;
+uniform vec2  image_k;
+uniform float image_g;
+uniform vec2  circle_p;
+uniform float circle_r;
+uniform int   clip_n;
+uniform float clip_k;
+uniform int   page_n;
+uniform float page_s;
+uniform float page_g;
+uniform vec2  page_k[16];
 
 /*----------------------------------------------------------------------------*/
 
-// a b c
-// d e f
-// g h i
+// Give the level of detail of a sample, by the footprint of lp-kernel.h.
+
+float footprint(float, float);
+
+// Sample image pixel q at level of detail d. A paged image gives the finest
+// resident page at or above that level, and any image falls back to its
+// texture, which is a preview if the image is paged. Both cover only the
+// loaded region of the image, and nothing is given beyond it.
+
+vec4 texel(vec2 q, float d)
+{
+    q = q - image_r.xy;
+
+    if (any(lessThan(q, vec2(0.0))) || any(greaterThanEqual(q, image_r.zw)))
+        return vec4(0.0);
+
+    for (int l = 0; l < 16; l++)
+        if (l < page_n && float(l) >= d)
+        {
+            vec2 t = q * page_k[l];
+            vec2 g = floor(t / page_s);
+            vec4 e = texture2DRect(table, vec2(g.x, g.y + float(l) * page_g)
+                                        + 0.5);
+            if (e.a > 0.0)
+                return texture2DRect(atlas, e.xy * (page_s + 2.0) + 1.0
+                                                 + t - g * page_s);
+        }
+
+    return texture2DRect(image, q * image_k);
+}
+
+// Give the log luminance of a color.
+
+float loglum(vec3 c)
+{
+    return log(max(dot(c, vec3(0.2126, 0.7152, 0.0722)), 1.0e-6));
+}
+
+// Place the warp coordinate within the image circle and sample at the level of
+// detail of its footprint. The weight was found in unit disc coordinates, so
+// scale it to image pixels. The image's exposure gain applies before all else.
+//
+// Clip pass 1 accumulates the weighted moments of log luminance. Clip pass 2
+// accumulates color as usual, but nearly drops samples more than clip_k
+// standard deviations from the weighted mean. Where every sample is dropped,
+// the remainders still give the plain mean. The deviation has a floor, so that
+// images in close agreement are never clipped.
 
 void main()
 {
-    vec2 p = gl_FragCoord.xy;
+    vec3  w = texture2DRect(warp, gl_FragCoord.xy).xyz;
+    float d = footprint(circle_r, w.z);
+    vec4  C = texel(circle_p + circle_r * w.xy, d);
+    float k = C.a * w.z / circle_r;
 
-    vec2 a = texture2DRect(coord, p + vec2(-1.0,  1.0)).xy;
-    vec2 b = texture2DRect(coord, p + vec2( 0.0,  1.0)).xy;
-    vec2 c = texture2DRect(coord, p + vec2( 1.0,  1.0)).xy;
-    vec2 d = texture2DRect(coord, p + vec2(-1.0,  0.0)).xy;
-    vec2 e = texture2DRect(coord, p + vec2( 0.0,  0.0)).xy;
-    vec2 f = texture2DRect(coord, p + vec2( 1.0,  0.0)).xy;
-    vec2 g = texture2DRect(coord, p + vec2(-1.0, -1.0)).xy;
-    vec2 h = texture2DRect(coord, p + vec2( 0.0, -1.0)).xy;
-    vec2 i = texture2DRect(coord, p + vec2( 1.0, -1.0)).xy;
+    C.rgb *= image_g;
 
-    vec2 x = -a - 2.0 * b - c + g + 2.0 * h + i;
-    vec2 y = -a - 2.0 * d - g + c + 2.0 * f + i;
+    if (clip_n == 1)
+    {
+        float l = loglum(C.rgb);
 
-    float D = length(vec2(length(x), length(y)));
-    vec4  C = texture2DRect(image, e);
+        gl_FragColor = vec4(k, k * l, k * l * l, 0.0);
+    }
+    else
+    {
+        if (clip_n == 2)
+        {
+            vec3  M = texture2DRect(moment, gl_FragCoord.xy).xyz;
+            float m = M.y / M.x;
+            float s = sqrt(max(M.z / M.x - m * m, 0.0));
 
-    gl_FragColor = vec4(C.rgb * C.a / D, C.a / D);
+            if (abs(loglum(C.rgb) - m) > clip_k * max(s, 0.1))
+                k *= 1.0e-4;
+        }
+        gl_FragColor = vec4(C.rgb * k, k);
+    }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -2,15 +2,15 @@
 
 varying vec3 V;
 
-uniform vec2  circle_p;
-uniform float circle_r;
-
 /*----------------------------------------------------------------------------*/
 
-vec2 unwrap(vec3 n)
-{
-    return circle_p + circle_r * n.xy * sin(0.5 * acos(n.z)) / length(n.xy);
-}
+// Map a chart coordinate to a direction, and that to the unit disc of an
+// angular map, and give the sampling weight of the result, as given by
+// lp-kernel.h.
+
+vec2  unwrap(vec3);
+float weight(vec2);
+vec3  chart (vec2);
 
 /*----------------------------------------------------------------------------*/
 
@@ -20,14 +20,9 @@ void main()
                   gl_TextureMatrix[0][1].xyz,
                   gl_TextureMatrix[0][2].xyz);
 
-    vec2 s = -V.xy * vec2(6.2831853, 3.1415927)
-                   + vec2(3.1415927, 1.5707963);
-
-    vec3 n = vec3((sin(s.x) * cos(s.y)),
-                  (          -sin(s.y)),
-                  (cos(s.x) * cos(s.y)));
+    vec2 u = unwrap(M * chart(V.xy));
 
-    gl_FragColor = vec4(unwrap(M * n), 0.0, 0.0);
+    gl_FragColor = vec4(u, weight(u), 0.0);
 }
 
 /*----------------------------------------------------------------------------*/
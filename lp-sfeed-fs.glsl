@@ -0,0 +1,49 @@
+#extension GL_ARB_texture_rectangle : enable
+
+uniform sampler2DRect warp;
+
+uniform vec4  image_r;
+uniform vec2  circle_p;
+uniform float circle_r;
+uniform float feed_k;
+uniform int   page_n;
+uniform float page_s;
+uniform vec2  page_k[16];
+
+/*----------------------------------------------------------------------------*/
+
+// Give the level of detail of a sample, by the footprint of lp-kernel.h.
+
+float footprint(float, float);
+
+/*----------------------------------------------------------------------------*/
+
+// Record the page that the blend will want at this pixel of a reduced view:
+// its column, row, and level, with an alpha of one where the image is seen.
+// The level of detail is the footprint of the blend at the warp texel read.
+// Pixels beyond the loaded region of the image want nothing, as do those
+// coarser than the coarsest level, where the blend falls back to the preview.
+
+void main()
+{
+    vec3  w = texture2DRect(warp, floor(gl_FragCoord.xy) * feed_k + 0.5).xyz;
+    vec2  q = circle_p + circle_r * w.xy - image_r.xy;
+    float d = footprint(circle_r, w.z);
+
+    if (w.z > 0.0 && d < float(page_n)
+                  && all(greaterThanEqual(q, vec2(0.0)))
+                  && all(lessThan        (q, image_r.zw)))
+    {
+        vec2 g = vec2(0.0);
+
+        for (int l = 0; l < 16; l++)
+            if (float(l) == d)
+                g = floor(q * page_k[l] / page_s);
+
+        gl_FragColor = vec4(g, d, 1.0);
+    }
+    else
+        gl_FragColor = vec4(0.0);
+}
+
+/*----------------------------------------------------------------------------*/
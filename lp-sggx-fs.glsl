@@ -0,0 +1,47 @@
+#extension GL_ARB_shader_texture_lod : enable
+
+uniform samplerCube cube;
+uniform vec4        samples[64];
+uniform int         face;
+uniform float       size;
+
+/*----------------------------------------------------------------------------*/
+
+// Map a cube face coordinate to a direction, as given by lp-kernel.h.
+
+vec3 direction(int, vec2);
+
+/*----------------------------------------------------------------------------*/
+
+// Importance sample the GGX lobe about the normal. Each sample gives the half
+// vector in tangent space and the mip level matching its solid angle.
+
+void main()
+{
+    vec2 c = 2.0 * gl_FragCoord.xy / size - 1.0;
+
+    vec3 N = normalize(direction(face, c));
+    vec3 U = (abs(N.z) < 0.999) ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 X = normalize(cross(U, N));
+    vec3 Y = cross(N, X);
+
+    vec3  C = vec3(0.0);
+    float W = 0.0;
+
+    for (int i = 0; i < 64; i++)
+    {
+        vec3  H = X * samples[i].x + Y * samples[i].y + N * samples[i].z;
+        vec3  L = 2.0 * dot(N, H) * H - N;
+        float k = dot(N, L);
+
+        if (k > 0.0)
+        {
+            C += textureCubeLod(cube, L, samples[i].w).rgb * k;
+            W += k;
+        }
+    }
+
+    gl_FragColor = vec4(C / W, 1.0);
+}
+
+/*----------------------------------------------------------------------------*/
@@ -2,15 +2,13 @@
 
 varying vec3 V;
 
-uniform vec2  circle_p;
-uniform float circle_r;
-
 /*----------------------------------------------------------------------------*/
 
-vec2 unwrap(vec3 n)
-{
-    return circle_p + circle_r * n.xy * sin(0.5 * acos(n.z)) / length(n.xy);
-}
+// Map a direction to the unit disc of an angular map, and give the sampling
+// weight of the result, as given by lp-kernel.h.
+
+vec2  unwrap(vec3);
+float weight(vec2);
 
 /*----------------------------------------------------------------------------*/
 
@@ -22,7 +20,9 @@ void main()
 
     vec3 n = normalize(vec3(-V.x, -V.y, -V.z));
 
-    gl_FragColor = vec4(unwrap(M * n), 0.0, 0.0);
+    vec2 u = unwrap(M * n);
+
+    gl_FragColor = vec4(u, weight(u), 0.0);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -0,0 +1,188 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lp-sh.h"
+#include "lp-task.h"
+#include "lp-kernel.h"
+
+//------------------------------------------------------------------------------
+
+// Evaluate the real spherical harmonic basis through band 3 for the unit
+// vector (x, y, z), in the usual l, m order.
+
+static void sh_basis(double x, double y, double z, double *Y)
+{
+    Y[ 0] = 0.282094792;
+
+    Y[ 1] = 0.488602512 * y;
+    Y[ 2] = 0.488602512 * z;
+    Y[ 3] = 0.488602512 * x;
+
+    Y[ 4] = 1.092548431 * x * y;
+    Y[ 5] = 1.092548431 * y * z;
+    Y[ 6] = 0.315391565 * (3.0 * z * z - 1.0);
+    Y[ 7] = 1.092548431 * x * z;
+    Y[ 8] = 0.546274215 * (x * x - y * y);
+
+    Y[ 9] = 0.590043589 * y * (3.0 * x * x - y * y);
+    Y[10] = 2.890611442 * x * y * z;
+    Y[11] = 0.457045799 * y * (5.0 * z * z - 1.0);
+    Y[12] = 0.373176333 * z * (5.0 * z * z - 3.0);
+    Y[13] = 0.457045799 * x * (5.0 * z * z - 1.0);
+    Y[14] = 1.445305721 * z * (x * x - y * y);
+    Y[15] = 0.590043589 * x * (x * x - 3.0 * y * y);
+}
+
+//------------------------------------------------------------------------------
+
+struct project
+{
+    const float  *p;
+    int           w;
+    int           h;
+    int           n;
+    const double *sx;
+    const double *cx;
+    double      (*sum)[SH_MAX][3];
+};
+
+typedef struct project project;
+
+// Accumulate the solid-angle-weighted projection of rows [i0, i1) of the chart
+// onto the basis, giving partial sums for chunk k.
+
+static void project_rows(void *data, int k, int i0, int i1)
+{
+    const project *P = (const project *) data;
+
+    const double dw = 2.0 * M_PI / P->w;
+    const double dh =       M_PI / P->h;
+
+    double (*S)[3] = P->sum[k];
+    double   Y[SH_MAX];
+    int      i;
+    int      j;
+    int      l;
+
+    for (i = i0; i < i1; i++)
+    {
+        const double x  = 2.0 * (i + 0.5) / P->h - 1.0;
+        const double xx = x * x;
+        const double ct = KERNEL_COS(xx);
+        const double st = KERNEL_SIN(x, xx);
+        const double da = ct * dw * dh;
+
+        const float *q = P->p + (size_t) i * P->w * 3;
+
+        for (j = 0; j < P->w; j++, q += 3)
+        {
+            const double r = q[0] * da;
+            const double g = q[1] * da;
+            const double b = q[2] * da;
+
+            sh_basis(P->sx[j] * ct, -st, P->cx[j] * ct, Y);
+
+            for (l = 0; l < P->n; l++)
+            {
+                S[l][0] += Y[l] * r;
+                S[l][1] += Y[l] * g;
+                S[l][2] += Y[l] * b;
+            }
+        }
+    }
+}
+
+// Project the W-by-H RGB chart P, as read back from an equirectangular render,
+// onto the first N spherical harmonic basis functions. Rows are bottom-up. The
+// direction of each pixel follows the chart projection, so the coefficients
+// are in the same frame as the chart and cube map exports. These are radiance
+// coefficients: scale bands 0, 1, and 2 by pi, 2pi/3, and pi/4 respectively
+// to give irradiance.
+
+void sh_project(const float *p, int w, int h, int n, float (*c)[3])
+{
+    const int m = task_count();
+
+    project P;
+    double *sx = (double *) malloc(w * sizeof (double));
+    double *cx = (double *) malloc(w * sizeof (double));
+    double (*sum)[SH_MAX][3] = calloc(m, sizeof (double [SH_MAX][3]));
+
+    int j, k, l;
+
+    memset(c, 0, n * sizeof (float [3]));
+
+    if (sx && cx && sum)
+    {
+        for (j = 0; j < w; j++)
+        {
+            const double x  = 1.0 - 2.0 * (j + 0.5) / w;
+            const double xx = x * x;
+            const double hs = KERNEL_SIN(x, xx);
+            const double hc = KERNEL_COS(xx);
+
+            sx[j] = 2.0 * hs * hc;
+            cx[j] = hc * hc - hs * hs;
+        }
+
+        P.p   = p;
+        P.w   = w;
+        P.h   = h;
+        P.n   = (n < SH_MAX) ? n : SH_MAX;
+        P.sx  = sx;
+        P.cx  = cx;
+        P.sum = sum;
+
+        task_split(h, project_rows, &P);
+
+        for     (k = 0; k < m;   k++)
+            for (l = 0; l < P.n; l++)
+            {
+                c[l][0] += (float) sum[k][l][0];
+                c[l][1] += (float) sum[k][l][1];
+                c[l][2] += (float) sum[k][l][2];
+            }
+    }
+
+    free(sum);
+    free(cx);
+    free(sx);
+}
+
+//------------------------------------------------------------------------------
+
+// Write N RGB coefficients to the named file, either as text with one
+// coefficient per line, or as raw native-endian 32-bit floats.
+
+void sh_write(const char *path, int n, float (*c)[3], int b)
+{
+    FILE *fp;
+    int   i;
+
+    if ((fp = fopen(path, b ? "wb" : "w")))
+    {
+        if (b)
+            fwrite(c, sizeof (float [3]), n, fp);
+        else
+            for (i = 0; i < n; i++)
+                fprintf(fp, "%+.9e %+.9e %+.9e\n", c[i][0], c[i][1], c[i][2]);
+
+        fclose(fp);
+    }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,27 @@
+#extension GL_ARB_texture_rectangle : enable
+
+varying vec3 V;
+
+/*----------------------------------------------------------------------------*/
+
+// Map a direction to the unit disc of an angular map, give the sampling weight
+// of the result, and decode the octahedral map, as given by lp-kernel.h.
+
+vec2  unwrap(vec3);
+float weight(vec2);
+vec3  octa  (vec2);
+
+/*----------------------------------------------------------------------------*/
+
+void main()
+{
+    mat3 M = mat3(gl_TextureMatrix[0][0].xyz,
+                  gl_TextureMatrix[0][1].xyz,
+                  gl_TextureMatrix[0][2].xyz);
+
+    vec2 u = unwrap(M * octa(V.xy));
+
+    gl_FragColor = vec4(u, weight(u), 0.0);
+}
+
+/*----------------------------------------------------------------------------*/
@@ -2,15 +2,15 @@
 
 varying vec3 V;
 
-uniform vec2  circle_p;
-uniform float circle_r;
-
 /*----------------------------------------------------------------------------*/
 
-vec2 unwrap(vec3 n)
-{
-    return circle_p + circle_r * n.xy * sin(0.5 * acos(n.z)) / length(n.xy);
-}
+// Map a polar coordinate to a direction, and that to the unit disc of an
+// angular map, and give the sampling weight of the result, as given by
+// lp-kernel.h.
+
+vec2  unwrap(vec3);
+float weight(vec2);
+vec3  polar (vec2);
 
 /*----------------------------------------------------------------------------*/
 
@@ -20,13 +20,9 @@ void main()
                   gl_TextureMatrix[0][1].xyz,
                   gl_TextureMatrix[0][2].xyz);
 
-    vec2 s = vec2(atan(V.x, V.y), 1.5707963 * (1.0 - length(V.xy)));
-
-    vec3 n = vec3((sin(s.x) * cos(s.y)),
-                  (          -sin(s.y)),
-                  (cos(s.x) * cos(s.y)));
+    vec2 u = unwrap(M * polar(V.xy));
 
-    gl_FragColor = vec4(unwrap(M * n), 0.0, 0.0);
+    gl_FragColor = vec4(u, weight(u), 0.0);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -0,0 +1,47 @@
+#extension GL_ARB_texture_rectangle : enable
+
+uniform sampler2DRect image;
+uniform vec2  image_s;
+uniform int   reduce_m;
+uniform vec2  stat_r;
+
+/*----------------------------------------------------------------------------*/
+
+// Reduce the 4x4 block of the image under this pixel by maximum. In mode 0 the
+// image is the accumulation buffer, and each covered texel gives the distances
+// of its log luminance from the ends of the range, as do the samples of the
+// statistics row. In mode 1 the image is the output of the pass before. Texels
+// beyond the edge of the image and uncovered texels give zero.
+
+void main()
+{
+    vec2 b = floor(gl_FragCoord.xy) * 4.0;
+    vec2 m = vec2(0.0);
+
+    for     (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+        {
+            vec2 q = b + vec2(float(j), float(i));
+
+            if (all(lessThan(q, image_s)))
+            {
+                vec4 p = texture2DRect(image, q + 0.5);
+
+                if (reduce_m == 1)
+                    m = max(m, p.rg);
+
+                else if (p.a > 0.0)
+                {
+                    float l = log2(dot(p.rgb / p.a,
+                                       vec3(0.2126, 0.7152, 0.0722)));
+
+                    l = clamp(l, stat_r.x, stat_r.y);
+                    m = max(m, vec2(l - stat_r.x, stat_r.y - l));
+                }
+            }
+        }
+
+    gl_FragColor = vec4(m, 0.0, 0.0);
+}
+
+/*----------------------------------------------------------------------------*/
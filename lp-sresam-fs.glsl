@@ -0,0 +1,39 @@
+#extension GL_ARB_shader_texture_lod : enable
+
+varying vec3 V;
+
+uniform samplerCube cube;
+uniform int         mode;
+uniform int         face;
+uniform float       size;
+uniform float       lod;
+
+/*----------------------------------------------------------------------------*/
+
+// Map a sphere vertex to a probe direction, as do the coordinate shaders, and a
+// cube face coordinate to a cube direction, by the mappings of lp-kernel.h.
+
+vec3 chart    (vec2);
+vec3 polar    (vec2);
+vec3 octa     (vec2);
+vec3 direction(int, vec2);
+
+/*----------------------------------------------------------------------------*/
+
+// Resample a blended cube map. Mode 0 renders one face of a GL cube map, and
+// the others render a chart, polar, or octahedral map of the sphere. The cube
+// holds probe direction n at cube direction -n.
+
+void main()
+{
+    vec3 d;
+
+    if      (mode == 1) d = -chart(V.xy);
+    else if (mode == 2) d = -polar(V.xy);
+    else if (mode == 3) d = -octa (V.xy);
+    else                d = direction(face, 2.0 * gl_FragCoord.xy / size - 1.0);
+
+    gl_FragColor = vec4(textureCubeLod(cube, d, lod).rgb, 1.0);
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,7 @@
+
+varying vec4 C;
+
+void main()
+{
+    gl_FragColor = C;
+}
@@ -0,0 +1,45 @@
+#extension GL_ARB_texture_rectangle : enable
+
+uniform sampler2DRect image;
+uniform vec2  image_s;
+uniform int   stat_m;
+uniform float stat_n;
+uniform vec2  stat_r;
+
+varying vec4 C;
+
+/*----------------------------------------------------------------------------*/
+
+// Scatter one sample of the accumulation buffer, at a vertex given in [0, 1],
+// to a row of N + 1 pixels: its log luminance bin in mode 0, and the running
+// sum and count at N in mode 1. Log luminance is clamped to the range, and
+// uncovered samples fall outside the row.
+
+void main()
+{
+    vec4  p = texture2DRect(image, gl_Vertex.xy * image_s);
+    float l = log2(dot(p.rgb / p.a, vec3(0.2126, 0.7152, 0.0722)));
+    float x;
+
+    l = clamp(l, stat_r.x, stat_r.y);
+
+    if (stat_m == 0)
+    {
+        x = floor((l - stat_r.x) / (stat_r.y - stat_r.x) * stat_n);
+        x = clamp(x, 0.0, stat_n - 1.0);
+        C = vec4(1.0, 0.0, 0.0, 0.0);
+    }
+    else
+    {
+        x = stat_n;
+        C = vec4(l, 1.0, 0.0, 0.0);
+    }
+
+    if (p.a > 0.0)
+        gl_Position = vec4(2.0 * (x + 0.5) / (stat_n + 1.0) - 1.0,
+                           0.0, 0.0, 1.0);
+    else
+        gl_Position = vec4(2.0, 2.0, 0.0, 1.0);
+}
+
+/*----------------------------------------------------------------------------*/
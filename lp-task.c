@@ -0,0 +1,89 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "lp-task.h"
+
+//------------------------------------------------------------------------------
+
+#define TASK_MAX 64
+
+struct task
+{
+    task_fn fn;
+    void   *data;
+    int     k;
+    int     i0;
+    int     i1;
+};
+
+typedef struct task task;
+
+static void *run(void *p)
+{
+    task *t = (task *) p;
+    t->fn(t->data, t->k, t->i0, t->i1);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+// Return the number of chunks a task will be split into: one per processor.
+
+int task_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (n < 1)        n = 1;
+    if (n > TASK_MAX) n = TASK_MAX;
+
+    return (int) n;
+}
+
+// Split N rows into contiguous chunks and process them in parallel, running
+// the first chunk on the calling thread. If a thread cannot be started, its
+// chunk is run in line. Return when all chunks are complete.
+
+void task_split(int n, task_fn fn, void *data)
+{
+    pthread_t p[TASK_MAX];
+    task      t[TASK_MAX];
+    int       r[TASK_MAX];
+    int       m = task_count();
+    int       k;
+
+    if (m > n) m = n;
+
+    for (k = 0; k < m; k++)
+    {
+        t[k].fn   = fn;
+        t[k].data = data;
+        t[k].k    = k;
+        t[k].i0   = (int) ((long long) n * (k    ) / m);
+        t[k].i1   = (int) ((long long) n * (k + 1) / m);
+    }
+
+    for (k = 1; k < m; k++)
+        if ((r[k] = pthread_create(p + k, 0, run, t + k)))
+            run(t + k);
+
+    if (m > 0)
+        run(t);
+
+    for (k = 1; k < m; k++)
+        if (r[k] == 0)
+            pthread_join(p[k], 0);
+}
+
+//------------------------------------------------------------------------------
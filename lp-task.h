@@ -0,0 +1,29 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef LP_TASK_H
+#define LP_TASK_H
+
+//------------------------------------------------------------------------------
+
+// A task function receives its data pointer, the index of the chunk it is
+// processing, and the range [i0, i1) of rows in that chunk. Chunk indices are
+// always less than task_count(), so callers may size per-chunk state by it.
+
+typedef void (*task_fn)(void *, int, int, int);
+
+int  task_count(void);
+void task_split(int, task_fn, void *);
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,180 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "lp-tone.h"
+#include "lp-task.h"
+
+//------------------------------------------------------------------------------
+
+// The sRGB encoding table spans the tone-mapped range [0, 1] finely enough that
+// adjacent entries never differ by more than one 8-bit step. Auto-exposure
+// maps the log-average luminance to the middle grey of the key.
+
+#define TONE_LUT 4096
+#define TONE_KEY 0.18
+
+// Encode a linear value in [0, 1] to sRGB.
+
+static double srgb(double v)
+{
+    return (v <= 0.0031308) ? v * 12.92 : 1.055 * pow(v, 1.0 / 2.4) - 0.055;
+}
+
+static int clamp(int i, int n)
+{
+    return (i < 0) ? 0 : ((i < n) ? i : n - 1);
+}
+
+//------------------------------------------------------------------------------
+
+// Tone mapping filters a supersampled render down by two, applies the curve of
+// the interactive view, and encodes it through a table. The filter is the
+// separable 4-tap tent [1 3 3 1] / 8, done as a vertical pass into a row of
+// scratch per chunk, a plain multiply-add over the row that vectorizes, and a
+// horizontal pass that feeds the curve. The rows are split across threads.
+
+struct tone
+{
+    const float         *p;
+    unsigned char       *q;
+    int                  w;
+    int                  h;
+    float                e;
+    float               *row;
+    const unsigned char *lut;
+};
+
+typedef struct tone tone;
+
+static void tone_rows(void *data, int t, int i0, int i1)
+{
+    const tone *T = (const tone *) data;
+
+    const int    W = 2 * T->w;
+    const int    H = 2 * T->h;
+    const size_t m = (size_t) W * 3;
+
+    float *r = T->row + (size_t) t * m;
+    size_t i;
+    int    x;
+    int    y;
+    int    k;
+
+    for (y = i0; y < i1; y++)
+    {
+        const float *p0 = T->p + clamp(2 * y - 1, H) * m;
+        const float *p1 = T->p + clamp(2 * y,     H) * m;
+        const float *p2 = T->p + clamp(2 * y + 1, H) * m;
+        const float *p3 = T->p + clamp(2 * y + 2, H) * m;
+
+        unsigned char *q = T->q + (size_t) y * T->w * 3;
+
+        for (i = 0; i < m; i++)
+            r[i] = (p0[i] + 3.0f * p1[i] + 3.0f * p2[i] + p3[i]) * 0.125f;
+
+        for (x = 0; x < T->w; x++)
+        {
+            const float *a = r + clamp(2 * x - 1, W) * 3;
+            const float *b = r + clamp(2 * x,     W) * 3;
+            const float *c = r + clamp(2 * x + 1, W) * 3;
+            const float *d = r + clamp(2 * x + 2, W) * 3;
+
+            for (k = 0; k < 3; k++)
+            {
+                float v = (a[k] + 3.0f * b[k] + 3.0f * c[k] + d[k]) * 0.125f;
+                float u = 1.0f - expf(-T->e * v);
+
+                // Pixels uncovered by any image are not numbers.
+
+                if (!(u > 0.0f))
+                    u = 0.0f;
+
+                q[x * 3 + k] = T->lut[(int) (u * (TONE_LUT - 1) + 0.5f)];
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Return the exposure that brings luminance L to the key.
+
+float tone_key(double l)
+{
+    return (float) (-log(1.0 - TONE_KEY) / l);
+}
+
+// Return the exposure that brings the log-average luminance of a W-by-H sphere
+// chart to the key. Rows are weighted by the solid angle they subtend, so that
+// the poles count no more than they cover.
+
+float tone_exposure(const float *p, int w, int h)
+{
+    double n = 0.0;
+    double d = 0.0;
+    int    x;
+    int    y;
+
+    for (y = 0; y < h; y++)
+    {
+        const double k = cos(M_PI * (0.5 - (y + 0.5) / h));
+
+        for (x = 0; x < w; x++)
+        {
+            const float *c = p + ((size_t) y * w + x) * 3;
+            const double l = 0.2126 * c[0] + 0.7152 * c[1] + 0.0722 * c[2];
+
+            if (isfinite(l) && l >= 0.0)
+            {
+                n += k * log(l + 1e-4);
+                d += k;
+            }
+        }
+    }
+
+    if (d > 0.0)
+        return tone_key(exp(n / d));
+    else
+        return 1.0f;
+}
+
+// Tone map a 2W-by-2H RGB float render P with exposure E to a W-by-H 8-bit
+// sRGB image Q. Rows are in the same order in both.
+
+void tone_map(unsigned char *q, const float *p, int w, int h, float e)
+{
+    unsigned char lut[TONE_LUT];
+    tone          T;
+    int           i;
+
+    for (i = 0; i < TONE_LUT; i++)
+        lut[i] = (unsigned char) (255.0 * srgb((double) i / (TONE_LUT - 1))
+                                                                     + 0.5);
+    T.p   = p;
+    T.q   = q;
+    T.w   = w;
+    T.h   = h;
+    T.e   = e;
+    T.lut = lut;
+
+    if ((T.row = (float *) malloc((size_t) task_count() * 2 * w * 3
+                                                        * sizeof (float))))
+    {
+        task_split(h, tone_rows, &T);
+        free(T.row);
+    }
+}
+
+//------------------------------------------------------------------------------
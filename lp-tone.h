@@ -0,0 +1,24 @@
+// LIGHTPROBE Copyright (C) 2010 Robert Kooima
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef LP_TONE_H
+#define LP_TONE_H
+
+//------------------------------------------------------------------------------
+
+float tone_key(double);
+float tone_exposure(const float *, int, int);
+void  tone_map(unsigned char *, const float *, int, int, float);
+
+//------------------------------------------------------------------------------
+
+#endif